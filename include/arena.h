@@ -0,0 +1,32 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "platform.h"
+
+// Cache line, also covers the widest SIMD vector (AVX-512)
+#define ARENA_ALIGNMENT 64
+
+#define ARENA_HUGE_PAGES (1u << 0)  // Prefer explicit, then transparent huge pages
+#define ARENA_PREFAULT   (1u << 1)  // Touch every page up front on the job system
+
+// Bump allocator for long-lived bulk simulation data. One OS mapping per
+// arena, allocations are never freed individually.
+typedef struct {
+    unsigned char* base;
+    size_t capacity;
+    size_t used;
+    PlatformPageKind pageKind;
+} Arena;
+
+bool arena_init(Arena* arena, size_t capacity, unsigned int flags);
+// ARENA_ALIGNMENT aligned, NULL when the arena is full
+void* arena_alloc(Arena* arena, size_t size);
+void arena_reset(Arena* arena);
+// Fault in [offset, offset + size) from all workers
+void arena_prefault(Arena* arena, size_t offset, size_t size);
+void arena_release(Arena* arena);
+const char* arena_page_kind_name(PlatformPageKind kind);
+
+#endif // ARENA_H
@@ -0,0 +1,48 @@
+#ifndef BUDGET_H
+#define BUDGET_H
+
+#include <stdbool.h>
+
+typedef enum {
+    BUDGET_HOLD,
+    BUDGET_GROW,
+    BUDGET_SHRINK
+} BudgetDecision;
+
+typedef struct {
+    bool enabled;
+
+    // Frame-time budget for particle step + draw (GPU time)
+    float targetMs;
+    // Dead band around the target, as a fraction of it
+    float hysteresis;
+    // Largest factor the count may grow by in one decision
+    float maxGrowth;
+
+    int minCount;
+    int maxCount;
+    int granularity;
+
+    // Frames to wait after a change before deciding again
+    int cooldownFrames;
+    int cooldown;
+
+    // Smoothed timings
+    float stepMs;
+    float drawMs;
+    float smoothing;
+    int samples;
+
+    BudgetDecision decision;
+    int lastCount;
+} ParticleBudget;
+
+// Initialize budget controller for a capacity of maxCount particles
+void budget_init(ParticleBudget* budget, float targetMs, int minCount, int maxCount, int granularity);
+
+// Feed measured step/draw timings, returns the active count to use next frame
+int budget_update(ParticleBudget* budget, float stepMs, float drawMs, int currentCount);
+
+const char* budget_decision_name(BudgetDecision decision);
+
+#endif // BUDGET_H
@@ -0,0 +1,31 @@
+#ifndef COLORMAP_H
+#define COLORMAP_H
+
+#include "glad/glad.h"
+
+#define COLORMAP_RESOLUTION 256
+#define COLORMAP_MAX_VELOCITY 8.0f
+
+typedef enum {
+    COLORMAP_MIAMI,
+    COLORMAP_INFERNO,
+    COLORMAP_VIRIDIS,
+    COLORMAP_RAINBOW,
+    COLORMAP_GRAYSCALE,
+    COLORMAP_COUNT
+} ColormapPalette;
+
+// Velocity-to-color transfer functions baked into one LUT row per palette.
+// Each particle group picks its row, palette is the default for new groups.
+typedef struct {
+    unsigned int texture;
+    int palette;
+} Colormap;
+
+void colormap_init(Colormap* colormap);
+void colormap_bind(Colormap* colormap, unsigned int program, int unit);
+void colormap_set_palette(Colormap* colormap, int palette);
+const char* colormap_palette_name(int palette);
+void colormap_cleanup(Colormap* colormap);
+
+#endif // COLORMAP_H
@@ -0,0 +1,28 @@
+#ifndef CPU_FEATURES_H
+#define CPU_FEATURES_H
+
+#include <stdbool.h>
+
+typedef enum {
+    SIMD_ISA_SSE2,
+    SIMD_ISA_AVX2,
+    SIMD_ISA_AVX512,
+    SIMD_ISA_COUNT
+} SimdIsa;
+
+typedef struct {
+    bool sse2;
+    bool avx2;     // AVX2 + FMA with OS YMM state support
+    bool avx512;   // AVX-512F with OS ZMM state support
+} CpuFeatures;
+
+// Detected once, cached afterwards
+const CpuFeatures* cpu_features(void);
+bool cpu_supports(SimdIsa isa);
+SimdIsa cpu_best_isa(void);
+
+const char* simd_isa_name(SimdIsa isa);
+// Returns -1 for unknown names
+int simd_isa_from_name(const char* name);
+
+#endif // CPU_FEATURES_H
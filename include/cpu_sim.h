@@ -0,0 +1,73 @@
+#ifndef CPU_SIM_H
+#define CPU_SIM_H
+
+#include <stdbool.h>
+#include "cglm/cglm.h"
+#include "arena.h"
+#include "platform.h"
+#include "simd_kernels.h"
+
+#define CPU_SIM_MAX_THREADS 256
+#define CPU_SIM_BENCH_STEPS 50
+
+typedef struct CpuSim CpuSim;
+
+// One pinned thread, it owns [begin, end) for the whole run
+typedef struct {
+    CpuSim* sim;
+    PlatformThread thread;
+    int node;
+    int cpu;
+    int begin;
+    int end;
+    bool pinned;
+    double seconds;         // Time of this thread's last command
+} CpuSimWorker;
+
+typedef struct {
+    int begin;              // Particle range placed in this node's memory
+    int end;
+    int firstWorker;
+    int workerCount;
+    double seconds;         // Slowest worker of the node in the last command
+} CpuSimNode;
+
+// Host-side particle simulation partitioned across NUMA nodes. Each node's
+// share of the arrays is first touched by threads pinned to that node, and
+// every step runs the same ranges on the same threads, so workers only ever
+// read memory local to their socket. Unlike the job system there is no
+// stealing here, stealing would move ranges across sockets.
+struct CpuSim {
+    int count;
+    int nodeCount;
+    CpuSimNode nodes[PLATFORM_MAX_NUMA_NODES];
+    int workerCount;
+    CpuSimWorker workers[CPU_SIM_MAX_THREADS];
+
+    Arena arena;
+    vec2* positions;
+    vec2* velocities;
+    float* speeds;
+    const SimdKernels* kernels;
+    SimdIntegrateParams params;
+
+    // Step handoff: the caller bumps generation and waits for remaining to hit zero
+    PlatformMutex mutex;
+    PlatformCond start;
+    PlatformCond done;
+    int command;
+    unsigned int generation;
+    int remaining;
+    double initSeconds;
+};
+
+// Partition count particles over the first maxNodes nodes (<= 0 for all) and
+// initialize them from the pinned workers
+bool cpu_sim_init(CpuSim* sim, int count, int maxNodes);
+void cpu_sim_step(CpuSim* sim, const SimdIntegrateParams* params);
+void cpu_sim_shutdown(CpuSim* sim);
+
+// Step time and per-node bandwidth on one node and on all of them
+void cpu_sim_benchmark(int particleCount);
+
+#endif // CPU_SIM_H
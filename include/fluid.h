@@ -0,0 +1,82 @@
+#ifndef FLUID_H
+#define FLUID_H
+
+#include "glad/glad.h"
+#include "cglm/cglm.h"
+#include <stdbool.h>
+#include "shader.h"
+
+// Cells per side, independent of the particle count
+#define FLUID_RESOLUTION 128
+#define FLUID_PRESSURE_ITERATIONS 40
+#define FLUID_LOCAL_SIZE 16
+
+typedef enum {
+    FLUID_SOLVER_CPU,
+    FLUID_SOLVER_GPU
+} FluidSolver;
+
+typedef enum {
+    FLUID_STAGE_SPLAT,
+    FLUID_STAGE_ADVECT,
+    FLUID_STAGE_BOUNDARY,
+    FLUID_STAGE_DIVERGENCE,
+    FLUID_STAGE_JACOBI,
+    FLUID_STAGE_GRADIENT,
+    FLUID_STAGE_COUNT
+} FluidStage;
+
+// Semi-Lagrangian stable-fluids velocity field over a square centered on the
+// origin. Grids are (size + 2)^2 with a one cell boundary ring. The solver runs
+// either on the CPU (job system + SIMD rows) or as compute passes; both leave
+// the result in velocityTextures[current] for the particles to sample.
+typedef struct {
+    bool enabled;
+    int solver;
+    int activeSolver;       // Solver that produced the current state
+    int size;
+    float extent;           // Half width of the covered square in world units
+    float cellSize;
+    float dissipation;      // Velocity decay per second
+    float coupling;         // Rate particles pick up the local flow, per second
+    float splatRadius;      // Drag footprint in world units
+    int pressureIterations;
+
+    // Mouse drag, injected on the next step
+    vec2 mousePos;
+    vec2 lastMousePos;
+    bool dragging;
+    bool wasDragging;
+
+    // CPU solver state
+    float* u;
+    float* v;
+    float* u0;
+    float* v0;
+    float* pressure;
+    float* pressure0;
+    float* divergence;
+    float* upload;          // Interleaved RG staging for the texture
+
+    // GPU solver state, also the CPU upload target
+    unsigned int velocityTextures[2];
+    unsigned int pressureTextures[2];
+    unsigned int divergenceTexture;
+    int current;
+    ShaderVariantCache stages;
+    unsigned int stagePrograms[FLUID_STAGE_COUNT];
+
+    float solveTimeMs;      // Host time of the last step, submission only for the GPU solver
+} FluidField;
+
+void fluid_init(FluidField* fluid, float extent, int size);
+void fluid_set_mouse(FluidField* fluid, float x, float y, bool dragging);
+void fluid_step(FluidField* fluid, float deltaTime);
+void fluid_reset(FluidField* fluid);
+unsigned int fluid_velocity_texture(const FluidField* fluid);
+// Texture coordinate of a world position is position * scale + offset
+void fluid_uv_transform(const FluidField* fluid, float* scale, float* offset);
+const char* fluid_solver_name(int solver);
+void fluid_cleanup(FluidField* fluid);
+
+#endif // FLUID_H
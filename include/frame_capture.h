@@ -0,0 +1,70 @@
+#ifndef FRAME_CAPTURE_H
+#define FRAME_CAPTURE_H
+
+#include "glad/glad.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include "arena.h"
+#include "platform.h"
+
+#define CAPTURE_PBO_COUNT 3
+#define CAPTURE_QUEUE_FRAMES 8
+
+typedef enum {
+    CAPTURE_FORMAT_PPM,     // frame_NNNNNN.ppm, binary RGB, top row first
+    CAPTURE_FORMAT_RAW      // frame_NNNNNN.rgba, RGBA8 exactly as read, bottom row first
+} CaptureFormat;
+
+typedef struct {
+    unsigned char* pixels;  // RGBA8, bottom row first
+    uint64_t frame;
+} CaptureFrame;
+
+// Offscreen render target read back to disk. Frames are rendered into an FBO,
+// read into a ring of pixel buffers behind fences and handed to a writer
+// thread once the GPU is done, so neither readback nor disk I/O blocks the
+// frame. Frames that would have to wait on either are dropped and counted.
+typedef struct {
+    int width;
+    int height;
+    int format;
+    char directory[512];
+
+    unsigned int framebuffer;
+    unsigned int colorBuffer;
+    unsigned int depthBuffer;
+
+    unsigned int pbos[CAPTURE_PBO_COUNT];
+    GLsync fences[CAPTURE_PBO_COUNT];
+    uint64_t pboFrames[CAPTURE_PBO_COUNT];
+    uint64_t frame;             // Frames rendered so far
+    uint64_t issued;            // Readbacks queued, picks the next pixel buffer
+
+    // Writer thread, frames queued in a ring of arena buffers
+    Arena arena;
+    CaptureFrame queue[CAPTURE_QUEUE_FRAMES];
+    int queueHead;
+    int queueCount;
+    bool stopping;
+    PlatformThread writer;
+    PlatformMutex mutex;
+    PlatformCond ready;         // Writer waits for frames
+    PlatformCond space;         // Flush waits for a free queue slot
+
+    uint64_t written;
+    uint64_t droppedReadback;   // GPU still busy with every pixel buffer
+    uint64_t droppedWriter;     // Disk behind, queue full
+    double startTime;
+} FrameCapture;
+
+bool frame_capture_init(FrameCapture* capture, const char* directory, int width, int height, int format);
+// Redirect rendering into the capture framebuffer
+void frame_capture_begin(FrameCapture* capture);
+// Queue the frame's readback and hand finished ones to the writer
+void frame_capture_end(FrameCapture* capture);
+// Wait for outstanding readbacks and writes, then stop the writer and report
+void frame_capture_finish(FrameCapture* capture);
+void frame_capture_cleanup(FrameCapture* capture);
+const char* frame_capture_format_name(int format);
+
+#endif // FRAME_CAPTURE_H
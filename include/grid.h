@@ -11,8 +11,14 @@ typedef struct {
     unsigned int shaderProgram;
     float size;
     float spacing;
+
+    // CPU-side vertices, released once uploaded
+    float* vertices;
+    int vertexCount;
 } Grid;
 
+// CPU-only, safe to run on a job thread before grid_init
+void grid_generate_vertices(Grid* grid, float size, float spacing);
 void grid_init(Grid* grid, float size, float spacing);
 void grid_render(Grid* grid, float* view, float* projection);
 void grid_cleanup(Grid* grid);
@@ -2,12 +2,57 @@
 #define HUD_H
 
 #include <GLFW/glfw3.h>
+#include <stdbool.h>
+#include "particle_stats.h"
+
+#define HUD_MAX_WORKERS 32
 
 typedef struct {
     float fps;
     int particleCount;
     float frameTime;
     float deltaTime;
+
+    // Particle budget controller
+    bool budgetEnabled;
+    const char* budgetDecision;
+    float stepTime;
+    float drawTime;
+    bool fusedUpdate;       // Stepped in the draw, there is no separate step time
+    float budgetTarget;
+    int particleCapacity;
+    float loadProgress;     // 0..1 while particles are streamed in
+
+    // Sparse update active set
+    bool sparseEnabled;
+    int activeTiles;
+    int totalTiles;
+
+    // Fluid solver
+    bool fluidEnabled;
+    const char* fluidSolver;
+    float fluidTime;
+
+    // Shared memory export
+    bool exportEnabled;
+    unsigned long long exportPublished;
+    unsigned long long exportDropped;
+    float exportTime;
+
+    // Brush and its spatial index
+    bool brushEnabled;
+    const char* brushOp;
+    int brushMatches;
+    int brushCells;
+    float brushBuildTime;
+    float brushQueryTime;
+
+    // Aggregate particle statistics
+    ParticleStats particleStats;
+
+    // Job system worker utilization (0..1)
+    float workerUtilization[HUD_MAX_WORKERS];
+    int workerCount;
 } HUDStats;
 
 typedef struct {
@@ -21,6 +66,17 @@ extern "C" {
 void hud_init(HUD* hud);
 void hud_render(HUD* hud);
 void hud_update_stats(HUD* hud, float fps, int particleCount, float frameTime, float deltaTime);
+void hud_update_budget(HUD* hud, bool enabled, const char* decision, float stepTime,
+                       float drawTime, bool fusedUpdate, float targetTime, int particleCapacity);
+void hud_update_particle_stats(HUD* hud, const ParticleStats* stats);
+void hud_update_activity(HUD* hud, bool enabled, int activeTiles, int totalTiles);
+void hud_update_fluid(HUD* hud, bool enabled, const char* solver, float solveTime);
+void hud_update_export(HUD* hud, bool enabled, unsigned long long published,
+                       unsigned long long dropped, float publishTime);
+void hud_update_brush(HUD* hud, bool enabled, const char* op, int matches, int cells,
+                      float buildTime, float queryTime);
+void hud_update_loading(HUD* hud, float progress);
+void hud_update_jobs(HUD* hud, const float* utilization, int workerCount);
 void hud_cleanup(HUD* hud);
 
 #ifdef __cplusplus
@@ -0,0 +1,41 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+
+#define JOB_MAX_WORKERS 32
+
+typedef void (*JobFunc)(void* data);
+typedef void (*JobRangeFunc)(void* data, int begin, int end);
+
+typedef struct Job Job;
+
+// Tracks outstanding jobs. Zero-initialize before first use; jobs submitted
+// "after" a counter start once it drops back to zero.
+typedef struct {
+    atomic_int pending;
+    atomic_flag lock;
+    Job* continuations;
+} JobCounter;
+
+// Start the scheduler; workerCount <= 0 picks one per core. The calling
+// thread becomes worker 0 and runs jobs while it waits.
+void job_system_init(int workerCount);
+void job_system_shutdown(void);
+int job_system_worker_count(void);
+
+void job_submit(JobCounter* counter, JobFunc func, void* data);
+// Run func once dependency has no pending jobs
+void job_submit_after(JobCounter* dependency, JobCounter* counter, JobFunc func, void* data);
+// Execute other jobs until counter reaches zero
+void job_wait(JobCounter* counter);
+bool job_done(JobCounter* counter);
+
+// Split [begin, end) into chunks of at least grain items and wait for all of them
+void job_parallel_for(int begin, int end, int grain, JobRangeFunc func, void* data);
+
+// Busy fraction of each worker since the previous call, returns worker count
+int job_system_utilization(float* utilization, int maxWorkers);
+
+#endif // JOB_SYSTEM_H
@@ -0,0 +1,56 @@
+#ifndef KERNEL_TUNER_H
+#define KERNEL_TUNER_H
+
+#include "particle_system.h"
+
+// Results per device and particle count, delete the file to tune again
+#define KERNEL_TUNER_CACHE_FILE "kernel_tuning.txt"
+#define KERNEL_TUNER_WARMUP 2
+#define KERNEL_TUNER_SAMPLES 5
+#define KERNEL_TUNER_MAX_CANDIDATES 8
+
+typedef struct {
+    int localSize;
+    int particlesPerInvocation;
+    float stepMs;
+    bool cached;
+} KernelTuning;
+
+typedef struct {
+    int localSize;
+    int particlesPerInvocation;
+    unsigned int program;
+} KernelCandidate;
+
+// Picks the update kernel's local size and particles per invocation for
+// this device while the simulation runs. Once streaming has loaded every
+// group, each frame issues one dispatch of the candidate being timed over
+// the loaded particles, with a table of its own that makes the step a no-op
+// (no time, force or damping).
+// Timer results are polled without waiting, the default kernel keeps
+// running until the fastest candidate is known.
+typedef struct {
+    unsigned long long device;
+    int particleCount;              // Loaded particles timed, also the cache key
+    ParticleKernelConfig base;      // Candidates differ only in the tuned fields
+    KernelCandidate candidates[KERNEL_TUNER_MAX_CANDIDATES];
+    int candidateCount;
+    int current;                    // Candidate being timed
+    int dispatched;                 // Its warmup and timed dispatches so far
+    unsigned int queries[KERNEL_TUNER_SAMPLES];
+    unsigned int tableBuffer;       // One entry per loaded group
+    int tableCount;
+    int workGroups;                 // Dispatch size of the current candidate
+    bool started;                   // Loading finished, the cache was checked
+    bool running;
+    KernelTuning result;
+} KernelTuner;
+
+// Nothing runs until the groups are loaded, then a cached result for that
+// particle count is applied or tuning starts
+void kernel_tuner_init(KernelTuner* tuner, ParticleSystem* ps);
+// Advance tuning by at most one dispatch, call once per frame after the update
+void kernel_tuner_step(KernelTuner* tuner, ParticleSystem* ps);
+void kernel_tuner_cleanup(KernelTuner* tuner);
+
+#endif // KERNEL_TUNER_H
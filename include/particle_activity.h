@@ -0,0 +1,44 @@
+#ifndef PARTICLE_ACTIVITY_H
+#define PARTICLE_ACTIVITY_H
+
+#include "glad/glad.h"
+#include <stdbool.h>
+
+#define ACTIVITY_LOCAL_SIZE 256
+#define ACTIVITY_READBACK_FRAMES 3
+// Tiles whose fastest particle is below this are left alone until the force reaches them
+#define ACTIVITY_REST_SPEED 0.01f
+
+// Sparse update bookkeeping. A tile is the range of particles one update
+// workgroup covers. The update kernel records each tile's bounds and peak
+// speed, and particle_activity.comp compacts the tiles that can still move
+// into the list consumed by an indirect dispatch.
+typedef struct {
+    unsigned int tileBuffer;
+    unsigned int listBuffer;
+    unsigned int dispatchBuffer;
+    unsigned int readbackBuffers[ACTIVITY_READBACK_FRAMES];
+    GLsync fences[ACTIVITY_READBACK_FRAMES];
+    int readbackTotals[ACTIVITY_READBACK_FRAMES];
+    unsigned int buildProgram;
+    int maxTiles;
+    unsigned int frame;
+    bool enabled;
+    float restSpeed;
+
+    // Latest readback, a few frames old
+    int activeTiles;
+    int totalTiles;
+} ActiveSet;
+
+void particle_activity_init(ActiveSet* set, int maxTiles);
+// Rebuild the list of tiles to update. wakeAll is needed whenever the
+// tile-to-particle mapping changed, since the recorded tile state is stale then.
+// Leaves the tile and list buffers bound for the update kernel.
+void particle_activity_build(ActiveSet* set, int totalTiles, const float* mousePos,
+                             float forceRadius, bool wakeAll, bool countResting);
+// Dispatch the update kernel over the active tiles only
+void particle_activity_dispatch(ActiveSet* set);
+void particle_activity_cleanup(ActiveSet* set);
+
+#endif // PARTICLE_ACTIVITY_H
@@ -0,0 +1,43 @@
+#ifndef PARTICLE_EXPORT_H
+#define PARTICLE_EXPORT_H
+
+#include "glad/glad.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include "platform.h"
+#include "particle_system.h"
+
+#define PARTICLE_EXPORT_READBACKS 3
+// Largest frame published, later groups are cut off past this
+#define PARTICLE_EXPORT_CAPACITY (4 * 1024 * 1024)
+
+struct ParticleExportHeader;
+
+// Publishes the active particles to a shared memory ring for other local
+// processes (layout in particle_export_format.h). Particle data is copied into
+// readback buffers on the GPU and written to the ring once its fence has
+// passed, a few frames later, so the render loop never waits on the export.
+typedef struct {
+    bool enabled;
+    int capacity;
+    PlatformSharedMemory shm;
+    struct ParticleExportHeader* header;  // NULL while not publishing
+
+    unsigned int readbackBuffers[PARTICLE_EXPORT_READBACKS];
+    GLsync fences[PARTICLE_EXPORT_READBACKS];
+    int readbackCounts[PARTICLE_EXPORT_READBACKS];
+    uint64_t readbackFrames[PARTICLE_EXPORT_READBACKS];
+    unsigned int frame;
+
+    uint64_t published;
+    uint64_t dropped;       // Frames skipped because every readback was in flight
+    float publishTimeMs;    // Host time spent writing the last slot
+} ParticleExporter;
+
+void particle_export_init(ParticleExporter* exporter, int capacity);
+// Call once per frame after the particle update, opens or closes the shared
+// memory block when enabled changes
+void particle_export_frame(ParticleExporter* exporter, const ParticleSystem* ps);
+void particle_export_cleanup(ParticleExporter* exporter);
+
+#endif // PARTICLE_EXPORT_H
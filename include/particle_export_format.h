@@ -0,0 +1,54 @@
+#ifndef PARTICLE_EXPORT_FORMAT_H
+#define PARTICLE_EXPORT_FORMAT_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+// Layout of the shared memory block published by particle_export.c. Shared
+// with tools/particle_consumer.c, so it only depends on the C library.
+//
+//   [ParticleExportHeader][slot 0][slot 1]...[slot slotCount - 1]
+//
+// Each slot is a ParticleExportSlot followed by the arrays named in layout,
+// structure of arrays at the offsets given in the header. Slots are written
+// round robin under their own seqlock: the sequence is odd while the engine
+// writes, a reader keeps its result only if the sequence is even and the
+// same before and after it read the slot.
+
+#define PARTICLE_EXPORT_NAME "/particle_engine_frames"
+#define PARTICLE_EXPORT_MAGIC 0x50585045u  // "EPXP"
+#define PARTICLE_EXPORT_VERSION 1
+#define PARTICLE_EXPORT_SLOTS 3
+
+#define PARTICLE_EXPORT_POSITIONS  (1u << 0)  // vec2 per particle
+#define PARTICLE_EXPORT_VELOCITIES (1u << 1)  // vec2 per particle
+
+typedef struct ParticleExportHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t layout;            // PARTICLE_EXPORT_* bits
+    uint32_t slotCount;
+    uint64_t slotCapacity;      // Particles a slot can hold
+    uint64_t slotStride;        // Bytes between slots
+    uint64_t firstSlot;         // Offset of slot 0 from the start of the block
+    uint64_t positionOffset;    // From the start of a slot
+    uint64_t velocityOffset;
+    _Atomic uint64_t latestFrame;  // Frame number of the newest complete slot
+    _Atomic uint32_t latestSlot;
+    _Atomic uint32_t alive;        // Cleared when the engine stops publishing
+} ParticleExportHeader;
+
+typedef struct {
+    _Atomic uint32_t sequence;  // Seqlock, odd while being written
+    uint32_t padding;
+    uint64_t frame;
+    uint64_t count;             // Valid particles in this slot
+    double time;                // Engine clock when written, seconds
+    uint8_t reserved[32];       // Keeps the arrays cache line aligned
+} ParticleExportSlot;
+
+static inline ParticleExportSlot* particle_export_slot(ParticleExportHeader* header, uint32_t slot) {
+    return (ParticleExportSlot*)((unsigned char*)header + header->firstSlot + slot * header->slotStride);
+}
+
+#endif // PARTICLE_EXPORT_FORMAT_H
@@ -0,0 +1,47 @@
+#ifndef PARTICLE_STATS_H
+#define PARTICLE_STATS_H
+
+#include "glad/glad.h"
+#include "cglm/cglm.h"
+#include <stdbool.h>
+
+#define STATS_HISTOGRAM_BINS 32
+#define STATS_HISTOGRAM_MAX_SPEED 8.0f
+#define STATS_READBACK_FRAMES 3
+#define STATS_LOCAL_SIZE 256
+
+// Aggregate statistics over the active particles, brush-deleted ones excluded
+typedef struct {
+    int count;
+    float kineticEnergy;
+    vec2 centerOfMass;
+    vec2 boundsMin;
+    vec2 boundsMax;
+    float maxSpeed;
+    unsigned int histogram[STATS_HISTOGRAM_BINS];
+    bool valid;
+} ParticleStats;
+
+// GPU-side reduction state. Per-workgroup partials are written by the
+// update kernel and folded down by particle_stats.comp until one remains.
+typedef struct {
+    unsigned int partialBuffer;
+    unsigned int histogramBuffer;
+    unsigned int readbackBuffers[STATS_READBACK_FRAMES];
+    GLsync fences[STATS_READBACK_FRAMES];
+    unsigned int reduceProgram;
+    int partialCapacity;
+    unsigned int frame;
+    bool enabled;
+    ParticleStats latest;
+} StatsReducer;
+
+void particle_stats_init(StatsReducer* stats, int maxWorkGroups);
+void particle_stats_begin(StatsReducer* stats);
+void particle_stats_reduce(StatsReducer* stats, int numWorkGroups);
+void particle_stats_cleanup(StatsReducer* stats);
+
+// Multithreaded SIMD reduction over host-side particle arrays
+void particle_stats_reduce_cpu(const vec2* positions, const vec2* velocities, int count, ParticleStats* out);
+
+#endif // PARTICLE_STATS_H
@@ -4,6 +4,103 @@
 #include "glad/glad.h"
 #include <GLFW/glfw3.h>
 #include "cglm/cglm.h"
+#include "particle_stats.h"
+#include "particle_activity.h"
+#include "colormap.h"
+#include "shader.h"
+#include "fluid.h"
+
+#define PARTICLE_TIMER_FRAMES 3
+#define PARTICLE_MIN_LOCAL_SIZE 64
+#define MAX_PARTICLE_GROUPS 64
+// Group ranges in the pooled buffers start on this boundary
+#define PARTICLE_GROUP_ALIGNMENT 1024
+// Species ids are one byte per particle, the table is kept small
+#define PARTICLE_MAX_SPECIES 8
+// Update and draw ranges, one per species present in a group
+#define MAX_PARTICLE_RUNS (MAX_PARTICLE_GROUPS * PARTICLE_MAX_SPECIES)
+#define PARTICLE_SPECIES_BINDING 16
+
+// Per-particle marks set by brushes, one byte per particle packed four to a uint
+#define PARTICLE_FLAG_FROZEN 0x01u
+#define PARTICLE_FLAG_DELETED 0x02u
+// Bits 2..7 hold a palette override plus one, 0 keeps the group palette
+#define PARTICLE_FLAG_PALETTE_SHIFT 2
+#define PARTICLE_FLAGS_BINDING 9
+
+typedef enum {
+    PARTICLE_INTEGRATOR_EULER,
+    PARTICLE_INTEGRATOR_SYMPLECTIC_EULER
+} ParticleIntegrator;
+
+// Compile-time configuration of the update kernel, one cached variant each
+typedef struct {
+    bool collectStats;
+    int integrator;
+    int localSize;
+    int particlesPerInvocation;  // 2 uses paired vec4 loads and stores
+    bool sparse;        // Update only the tiles in the active set
+    bool fluid;         // Drag particles toward the fluid velocity field
+    bool flags;         // Honor the per-particle brush marks
+} ParticleKernelConfig;
+
+// Kind of particle. Its factors scale the parameters of the group the
+// particle lives in, so species 0 with all ones is the plain group.
+typedef struct {
+    const char* name;
+    float mass;         // Divides the mouse pull and the fluid drag
+    float attraction;   // Negative is pushed away from the mouse
+    float damping;
+    int palette;        // -1 keeps the group palette
+} ParticleSpecies;
+
+// Parameters of one independent particle system living in the shared pool
+typedef struct {
+    int capacity;
+    vec2 center;
+    float extent;
+    float attraction;
+    float damping;
+    int palette;
+    uint32_t seed;
+    float speciesMix[PARTICLE_MAX_SPECIES];  // Relative shares, all zero is species 0 only
+} ParticleGroupDesc;
+
+// Particles of one species are contiguous within their group, so no
+// update workgroup or draw range ever mixes two species
+typedef struct {
+    int species;
+    int offset;      // First particle within the group, a multiple of PARTICLE_GROUP_ALIGNMENT
+    int capacity;
+} SpeciesRun;
+
+typedef struct {
+    int id;
+    int offset;      // First particle in the pooled buffers
+    int capacity;
+    int count;       // Requested active particles, scaled by the budget
+    int scheduled;   // Particles handed to the generator so far
+    int loaded;      // Particles uploaded so far, only these are simulated
+    ParticleGroupDesc desc;
+    SpeciesRun runs[PARTICLE_MAX_SPECIES];
+    int runCount;
+} ParticleGroup;
+
+// Matches struct ParticleGroup in the shaders (std430). One entry per
+// non-empty species run, with the species factors already applied.
+typedef struct {
+    uint32_t offset;
+    uint32_t count;
+    uint32_t firstWorkGroup;
+    uint32_t palette;
+    float attraction;
+    float damping;
+    float invMass;
+    uint32_t species;
+} ParticleGroupGPU;
+
+// Background generation and chunked upload of group particles
+typedef struct ParticleStreamer ParticleStreamer;
 
 typedef struct {
     // Buffers
@@ -11,16 +108,67 @@ typedef struct {
     unsigned int velocityBuffer;
     unsigned int velocityMagBuffer;
     unsigned int particleVAO;
+    unsigned int pullVAO;       // No attributes, the fused pass reads the SSBOs itself
+    unsigned int flagBuffer;    // Brush marks, created the first time a brush needs them
+    unsigned int speciesBuffer; // Species id per particle, one byte each, created with the first mixed group
     
     // Shaders
     unsigned int computeProgram;
     unsigned int renderProgram;
+    ShaderVariantCache renderVariants;
+    ShaderVariantCache computeVariants;
+    ParticleKernelConfig kernel;        // Requested configuration
+    ParticleKernelConfig activeKernel;  // Configuration computeProgram was built for
     
     // Particle data
-    int numParticles;
-    int count;
+    int numParticles;   // Allocated pool capacity
+    int count;          // Active particles over all groups, updated and drawn
     float deltaTime;
     vec2 mousePos;
+    float forceRadius;  // Reach of the mouse force, <= 0 is unlimited
+    const FluidField* fluid;  // Optional flow field, used while enabled
+    bool fused;             // Integrate in the vertex shader instead of a compute pass
+    bool fusedSupported;
+    bool fusedDrawn;        // The last draw integrated, its step timer measured nothing
+    bool flagsInUse;        // Some particle may carry a mark, kernels read flagBuffer
+    GLint vertexStorageBlocks;
+
+    // GPU timings, read back a few frames late to avoid stalls
+    unsigned int stepQueries[PARTICLE_TIMER_FRAMES];
+    unsigned int drawQueries[PARTICLE_TIMER_FRAMES];
+    unsigned int queryFrame;
+    float stepTimeMs;
+    float drawTimeMs;
+
+    // Live aggregate statistics
+    StatsReducer stats;
+
+    // Tiles that still move, sparse updates skip the rest
+    ActiveSet activity;
+    bool tilesStale;    // Tile layout changed since the tile state was recorded
+
+    // Velocity colormap LUT
+    Colormap colormap;
+
+    // Independent systems sharing the pool, sorted by offset
+    ParticleGroup groups[MAX_PARTICLE_GROUPS];
+    int groupCount;
+    int nextGroupId;
+    unsigned int groupTableBuffer;
+    unsigned int drawCommandBuffer;  // One indirect draw per table entry, baseInstance is the entry
+    unsigned int drawInstanceBuffer; // Table entry and palette per run, read per instance
+    ParticleGroupGPU uploadedTable[MAX_PARTICLE_RUNS];
+    int tableCount;
+    int workGroupCount;
+    GLint drawFirsts[MAX_PARTICLE_RUNS];
+    GLsizei drawCounts[MAX_PARTICLE_RUNS];
+
+    // Species table, indexed by the per-particle species id
+    ParticleSpecies species[PARTICLE_MAX_SPECIES];
+    int speciesCount;
+
+    // Progressive loading, groups fill in as chunks land
+    ParticleStreamer* streamer;
     
     // Legacy members (can be removed if not used)
     float* positions;
@@ -32,10 +180,41 @@ typedef struct {
     unsigned int computeShader;
 } ParticleSystem;
 
+// Allocates buffers only, so particle generation can start before the
+// shaders are compiled by particle_system_load_shaders
 void particle_system_init(ParticleSystem* ps);
+void particle_system_load_shaders(ParticleSystem* ps);
 void particle_system_update(ParticleSystem* ps);
 void particle_system_render(ParticleSystem* ps, mat4 view, mat4 projection);
 void particle_system_cleanup(ParticleSystem* ps);
 void particle_system_set_mouse_pos(ParticleSystem* ps, float x, float y);
+// Returns the count applied, groups and species runs round it down
+int particle_system_set_active_count(ParticleSystem* ps, int count);
+
+// Allocate a range of the pool for a new system, returns its id or -1
+int particle_system_add_group(ParticleSystem* ps, const ParticleGroupDesc* desc);
+void particle_system_remove_group(ParticleSystem* ps, int id);
+void particle_system_clear_groups(ParticleSystem* ps);
+void particle_system_set_palette(ParticleSystem* ps, int palette);
+int particle_system_group_capacity(ParticleSystem* ps);
+
+// Upload generated chunks (a few per call) and keep the generators busy
+void particle_system_stream(ParticleSystem* ps);
+// Fraction of the group capacity uploaded so far, 1 once loading is done
+float particle_system_load_progress(ParticleSystem* ps);
+
+// Look up (or compile on first use) the update kernel variant for ps->kernel
+unsigned int particle_system_kernel(ParticleSystem* ps);
+// Same lookup for any configuration, leaves the active kernel alone. 0 if
+// the variant does not build.
+unsigned int particle_system_kernel_variant(ParticleSystem* ps, const ParticleKernelConfig* config);
+
+// Allocate the brush marks on first use, the kernels honor them from the next frame
+void particle_system_enable_flags(ParticleSystem* ps);
+// Unfreeze, undelete and restore the colors of every particle
+void particle_system_clear_flags(ParticleSystem* ps);
+// Allocate the species ids on first use and fill them from the groups' runs.
+// Until then every particle is species 0.
+void particle_system_enable_species(ParticleSystem* ps);
 
 #endif // PARTICLE_SYSTEM_H 
\ No newline at end of file
@@ -0,0 +1,105 @@
+#ifndef PLATFORM_H
+#define PLATFORM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+
+// Thin wrappers over Win32 / POSIX threading and timing
+
+typedef void (*PlatformThreadFunc)(void* arg);
+
+typedef struct {
+#ifdef _WIN32
+    void* handle;
+#else
+    pthread_t handle;
+#endif
+} PlatformThread;
+
+typedef struct {
+#ifdef _WIN32
+    void* lock;  // SRWLOCK
+#else
+    pthread_mutex_t lock;
+#endif
+} PlatformMutex;
+
+typedef struct {
+#ifdef _WIN32
+    void* cond;  // CONDITION_VARIABLE
+#else
+    pthread_cond_t cond;
+#endif
+} PlatformCond;
+
+// What ended up backing a platform_alloc_pages block
+typedef enum {
+    PLATFORM_PAGES_NORMAL,
+    PLATFORM_PAGES_TRANSPARENT_HUGE,  // Regular mapping with huge pages advised (Linux THP)
+    PLATFORM_PAGES_HUGE               // Explicit large pages (MAP_HUGETLB / MEM_LARGE_PAGES)
+} PlatformPageKind;
+
+// Named memory other processes can map (POSIX shm_open / Win32 file mapping)
+typedef struct {
+    void* memory;
+    size_t size;
+#ifdef _WIN32
+    void* handle;
+#else
+    int fd;
+#endif
+    char name[64];
+} PlatformSharedMemory;
+
+double platform_time_seconds(void);
+int platform_cpu_count(void);
+void platform_yield(void);
+void platform_sleep_ms(int milliseconds);
+
+bool platform_thread_create(PlatformThread* thread, PlatformThreadFunc func, void* arg);
+void platform_thread_join(PlatformThread* thread);
+
+void platform_mutex_init(PlatformMutex* mutex);
+void platform_mutex_lock(PlatformMutex* mutex);
+void platform_mutex_unlock(PlatformMutex* mutex);
+void platform_mutex_destroy(PlatformMutex* mutex);
+
+void platform_cond_init(PlatformCond* cond);
+void platform_cond_wait(PlatformCond* cond, PlatformMutex* mutex);
+// Returns false on timeout
+bool platform_cond_timed_wait(PlatformCond* cond, PlatformMutex* mutex, int milliseconds);
+void platform_cond_signal(PlatformCond* cond);
+void platform_cond_broadcast(PlatformCond* cond);
+void platform_cond_destroy(PlatformCond* cond);
+
+size_t platform_page_size(void);
+size_t platform_huge_page_size(void);
+// Zeroed, page-aligned memory straight from the OS. size must be a multiple of
+// platform_huge_page_size(). Prefers huge pages when asked, kind reports the outcome.
+void* platform_alloc_pages(size_t size, bool preferHuge, PlatformPageKind* kind);
+void platform_free_pages(void* memory, size_t size);
+
+// NUMA topology. Machines without NUMA (or without the information) report
+// one node holding every CPU.
+#define PLATFORM_MAX_NUMA_NODES 8
+int platform_numa_node_count(void);
+// Fills cpus with the logical CPU ids of node, returns how many
+int platform_numa_node_cpus(int node, int* cpus, int maxCpus);
+// Pin the calling thread to one logical CPU
+bool platform_thread_pin(int cpu);
+
+// True if the directory exists afterwards, parents are not created
+bool platform_make_directory(const char* path);
+
+// name starts with '/', e.g. "/particle_export"
+bool platform_shared_memory_create(PlatformSharedMemory* shm, const char* name, size_t size);
+// Map an existing block, size is taken from the block
+bool platform_shared_memory_open(PlatformSharedMemory* shm, const char* name);
+// The creator passes remove = true so the name goes away with it
+void platform_shared_memory_close(PlatformSharedMemory* shm, bool remove);
+
+#endif // PLATFORM_H
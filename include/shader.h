@@ -2,10 +2,51 @@
 #define SHADER_H
 
 #include <glad/glad.h>
+#include <stdint.h>
+
+#define SHADER_MAX_STAGES 2
+#define SHADER_INITIAL_VARIANTS 16
+#define SHADER_VARIANT_KEY_LENGTH 256
+
+typedef struct {
+    const char* name;
+    const char* value;
+} ShaderDefine;
+
+// Specialized programs built from the same sources, keyed by their define set
+typedef struct {
+    uint64_t hash;
+    char key[SHADER_VARIANT_KEY_LENGTH];
+    unsigned int program;   // 0 if the variant failed to link, it is not built again
+} ShaderVariant;
+
+typedef struct {
+    const char* label;
+    char* sources[SHADER_MAX_STAGES];
+    GLenum types[SHADER_MAX_STAGES];
+    int stageCount;
+    ShaderVariant* variants;    // Grows as new define sets are requested
+    int variantCount;
+    int variantCapacity;
+} ShaderVariantCache;
 
 // Function declarations
 char* read_shader_file(const char* filename);
+// Read several files concurrently on the job system
+void read_shader_files(const char* const* filenames, char** sources, int count);
 unsigned int compile_shader(const char* source, GLenum type);
 void check_program_linking(unsigned int program, const char* type);
 
-#endif // SHADER_H 
\ No newline at end of file
+// Insert #defines right after the #version line, caller frees the result
+char* inject_shader_defines(const char* source, const ShaderDefine* defines, int defineCount);
+
+// Variant cache: sources are read once, programs are compiled on first request.
+// Returns 0 for a variant that does not link, without recompiling it.
+int shader_variant_cache_init(ShaderVariantCache* cache, const char* label,
+                              const char* const* filenames, const GLenum* types, int stageCount);
+unsigned int shader_variant_cache_get(ShaderVariantCache* cache, const ShaderDefine* defines, int defineCount);
+// Delete one compiled variant, e.g. candidates an autotuner rejected
+void shader_variant_cache_release(ShaderVariantCache* cache, unsigned int program);
+void shader_variant_cache_cleanup(ShaderVariantCache* cache);
+
+#endif // SHADER_H 
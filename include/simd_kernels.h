@@ -0,0 +1,55 @@
+#ifndef SIMD_KERNELS_H
+#define SIMD_KERNELS_H
+
+#include <stdint.h>
+#include "cglm/cglm.h"
+#include "cpu_features.h"
+#include "particle_stats.h"
+
+typedef struct {
+    float mouse[2];
+    float attraction;
+    float damping;
+    float deltaTime;
+} SimdIntegrateParams;
+
+// Partial statistics over one particle range, merged by the caller
+typedef struct {
+    double sumPos[2];
+    double kinetic;
+    float minPos[2];
+    float maxPos[2];
+    float maxSpeedSq;
+    unsigned int histogram[STATS_HISTOGRAM_BINS];
+} SimdStatsResult;
+
+// CPU particle kernels, one table per instruction set built from simd_kernels.inl
+typedef struct {
+    SimdIsa isa;
+    void (*init_positions)(vec2* positions, int count, const float center[2], float extent, uint32_t seed);
+    void (*zero_velocities)(vec2* velocities, int count);
+    void (*integrate)(vec2* positions, vec2* velocities, float* speeds, int count, const SimdIntegrateParams* params);
+    void (*reduce_stats)(const vec2* positions, const vec2* velocities, int count, SimdStatsResult* result);
+
+    // Stable-fluids solver, one row of interior cells per call on (size + 2)^2 grids
+    void (*fluid_advect_row)(float* outU, float* outV, const float* u, const float* v,
+                             int row, int size, float dt0, float decay);
+    void (*fluid_divergence_row)(float* divergence, const float* u, const float* v, int row, int size, float scale);
+    void (*fluid_jacobi_row)(float* out, const float* pressure, const float* divergence, int row, int size);
+    void (*fluid_gradient_row)(float* u, float* v, const float* pressure, int row, int size, float scale);
+} SimdKernels;
+
+extern const SimdKernels simd_kernels_sse2;
+extern const SimdKernels simd_kernels_avx2;
+extern const SimdKernels simd_kernels_avx512;
+
+// Select kernels once at startup, forcedIsa (e.g. "avx2") overrides detection
+void simd_dispatch_init(const char* forcedIsa);
+const SimdKernels* simd_get(void);
+// NULL when the CPU can't run the requested instruction set
+const SimdKernels* simd_kernels_for(SimdIsa isa);
+
+// Print per-ISA throughput for every kernel the CPU supports
+void simd_benchmark(int particleCount);
+
+#endif // SIMD_KERNELS_H
@@ -0,0 +1,121 @@
+#ifndef SPATIAL_INDEX_H
+#define SPATIAL_INDEX_H
+
+#include "glad/glad.h"
+#include "cglm/cglm.h"
+#include <stdbool.h>
+#include "shader.h"
+#include "particle_system.h"
+
+// Cells per side. The prefix sum scans SPATIAL_SCAN_SIZE cells per workgroup
+// and the block totals in a single workgroup, so cells must be <= SCAN_SIZE^2.
+#define SPATIAL_INDEX_RESOLUTION 1024
+#define SPATIAL_INDEX_EXTENT 32.0f
+#define SPATIAL_SCAN_SIZE 1024
+#define SPATIAL_LOCAL_SIZE 256
+// Matching indices kept for the caller, the match count itself is exact
+#define SPATIAL_QUERY_MAX_RESULTS (1 << 20)
+#define SPATIAL_READBACK_FRAMES 3
+
+// Storage bindings of spatial_index.comp, positions and velocities keep 0 and 1
+#define SPATIAL_BINDING_COUNTS 10
+#define SPATIAL_BINDING_STARTS 11
+#define SPATIAL_BINDING_BLOCKS 12
+#define SPATIAL_BINDING_INDICES 13
+#define SPATIAL_BINDING_RESULT 14
+#define SPATIAL_BINDING_SELECTION 15
+
+typedef enum {
+    SPATIAL_STAGE_COUNT_CELLS,
+    SPATIAL_STAGE_SCAN_BLOCKS,
+    SPATIAL_STAGE_SCAN_TOTALS,
+    SPATIAL_STAGE_ADD_OFFSETS,
+    SPATIAL_STAGE_SCATTER,
+    SPATIAL_STAGE_QUERY,
+    SPATIAL_STAGE_COUNT
+} SpatialStage;
+
+typedef enum {
+    SPATIAL_QUERY_RADIUS,
+    SPATIAL_QUERY_BOX
+} SpatialQueryShape;
+
+typedef enum {
+    BRUSH_NONE,
+    BRUSH_SELECT,       // Only collect the matching indices
+    BRUSH_PUSH,         // Impulse away from the center
+    BRUSH_FREEZE,
+    BRUSH_THAW,
+    BRUSH_RECOLOR,
+    BRUSH_DELETE,
+    BRUSH_OP_COUNT
+} BrushOp;
+
+// World space region, e.g. around screen_to_world_coords of the cursor
+typedef struct {
+    int shape;
+    vec2 center;
+    float radius;       // SPATIAL_QUERY_RADIUS
+    vec2 halfExtent;    // SPATIAL_QUERY_BOX
+} SpatialQuery;
+
+typedef struct {
+    int op;
+    int shape;
+    float radius;       // Also the half width of the box brush
+    float strength;     // Push impulse in units per second
+    int palette;        // Recolor target
+    int species;        // Only particles of this species, -1 for all
+} Brush;
+
+// Uniform grid over the particle pool, rebuilt on the GPU by a counting sort:
+// particles are counted per cell, the counts are prefix summed into cell
+// starts and the particle indices scattered into cell order. A query then
+// only visits the cells overlapping its region, so its cost follows the
+// particles near the region instead of the pool size. Particles outside the
+// grid are clamped into the border cells, queries still test exact positions.
+typedef struct {
+    int resolution;
+    float extent;       // Half width of the covered square in world units
+    float cellSize;
+    int capacity;       // Particles the index buffer holds, 0 until the first build, -1 if it failed
+
+    unsigned int countBuffer;       // Particles per cell, reused as scatter cursors
+    unsigned int startBuffer;       // Cell starts, cells + 1 entries
+    unsigned int blockBuffer;       // Per-scan-block totals
+    unsigned int indexBuffer;       // Particle indices in cell order
+    unsigned int resultBuffer;      // Match count, stored count
+    unsigned int selectionBuffer;   // Up to SPATIAL_QUERY_MAX_RESULTS matching indices
+    ShaderVariantCache stages;
+    unsigned int stagePrograms[SPATIAL_STAGE_COUNT];
+    unsigned int queryFlagsProgram;  // Query that reads and writes the brush marks
+    bool built;         // Index matches the positions of this frame
+
+    // Timings and match counts, read back a few frames late
+    unsigned int buildQueries[SPATIAL_READBACK_FRAMES];
+    unsigned int queryQueries[SPATIAL_READBACK_FRAMES];
+    unsigned int readbackBuffers[SPATIAL_READBACK_FRAMES];
+    GLsync fences[SPATIAL_READBACK_FRAMES];
+    bool queried[SPATIAL_READBACK_FRAMES];
+    bool recording;     // This frame's slot is free, timings and the readback go to it
+    unsigned int frame;
+
+    float buildTimeMs;
+    float queryTimeMs;
+    int matches;        // Particles in the last region read back
+    int cellsVisited;
+} SpatialIndex;
+
+void spatial_index_init(SpatialIndex* index, float extent, int resolution);
+// Sort this frame's positions into the grid. Allocates on first use.
+void spatial_index_build(SpatialIndex* index, ParticleSystem* ps);
+// Find the particles in the region and apply the brush to them. Needs a
+// build this frame. Matching indices are left in selectionBuffer.
+void spatial_index_query(SpatialIndex* index, ParticleSystem* ps, const SpatialQuery* query,
+                         const Brush* brush, float deltaTime);
+// Fence the frame's build and query for the non-blocking readback
+void spatial_index_end_frame(SpatialIndex* index);
+void spatial_index_cleanup(SpatialIndex* index);
+const char* brush_op_name(int op);
+
+#endif // SPATIAL_INDEX_H
@@ -20,6 +20,8 @@ void ui_render(UI* ui, World* world);
 void ui_end_frame(void);
 void ui_cleanup(UI* ui);
 void ui_toggle(UI* ui);
+// The cursor is over a window or menu, mouse input belongs to the UI
+bool ui_wants_mouse(void);
 
 #ifdef __cplusplus
 }
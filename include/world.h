@@ -6,12 +6,44 @@
 #include "camera.h"
 #include "ui.h"
 #include "hud.h"
+#include "budget.h"
+#include "fluid.h"
+#include "particle_export.h"
+#include "spatial_index.h"
+#include "kernel_tuner.h"
+
+// Two-pass (compute + draw) against fused (draw only) GPU time, run once the
+// pool has finished loading. One draw per path also counts its vertex shader
+// invocations: more than one per particle means the fused path stepped some
+// particles twice.
+typedef struct {
+    bool requested;
+    bool running;
+    int phase;              // 0 two-pass, 1 fused
+    int frame;
+    double gpuMs[2];
+    double frameMs[2];
+    int samples[2];
+    unsigned int invocationQueries[2];
+    int countPhase;         // Draw of this frame is counted for that phase, -1 for none
+    int drawnParticles[2];  // 0 if that phase wasn't counted
+    bool savedFused;
+    bool savedStats;
+    bool savedBudget;
+} RenderBenchmark;
 
 struct World {
     Grid grid;
     ParticleSystem particles;
     UI ui;
     HUD hud;
+    ParticleBudget budget;
+    FluidField fluid;
+    ParticleExporter exporter;
+    SpatialIndex spatialIndex;
+    Brush brush;            // Applied under the cursor while the right button is held
+    KernelTuner kernelTuner;
+    RenderBenchmark renderBenchmark;
     GLFWwindow* window;
 };
 
@@ -21,5 +53,9 @@ void world_init(World* world, GLFWwindow* window);
 void world_render(World* world, Camera* camera);
 void world_cleanup(World* world);
 void world_set_mouse_pos(World* world, float x, float y);
+// systemCount groups, each an equal mix of the first speciesCount species
+void world_load_scene(World* world, int systemCount, int speciesCount);
+// Compare the fused and two-pass paths, prints the result and closes the window
+void world_request_render_benchmark(World* world);
 
 #endif // WORLD_H
\ No newline at end of file
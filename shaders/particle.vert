@@ -1,15 +1,158 @@
 #version 430 core
+
+// FUSED_UPDATE integrates in this pass instead of particle.comp: the state is
+// pulled from the SSBOs by gl_VertexID, stepped and written back before the
+// point is emitted. Injected by particle_system.c together with INTEGRATOR.
+#ifndef FUSED_UPDATE
+#define FUSED_UPDATE 0
+#endif
+
+// PARTICLE_FLAGS applies the brush marks: deleted points are culled,
+// recolored ones use their own palette row and frozen ones are not stepped
+#ifndef PARTICLE_FLAGS
+#define PARTICLE_FLAGS 0
+#endif
+
+#define INTEGRATOR_EULER 0
+#define INTEGRATOR_SYMPLECTIC_EULER 1
+#ifndef INTEGRATOR
+#define INTEGRATOR INTEGRATOR_EULER
+#endif
+
+#if FUSED_UPDATE
+layout(std430, binding = 0) buffer Position {
+    vec2 positions[];
+};
+
+layout(std430, binding = 1) buffer Velocity {
+    vec2 velocities[];
+};
+
+uniform float delta_time;
+uniform vec2 mouse_pos;
+uniform float force_radius;  // <= 0 reaches every particle
+
+// Table entry of this vertex's run, replaces a per-vertex search of the table
+layout (location = 2) in uint aDrawIndex;
+#else
 layout (location = 0) in vec2 aPos;
 layout (location = 1) in float aVelocityMag;
+#endif
+
+// Every run is its own indirect draw with one instance and baseInstance set
+// to its table entry, so per-instance attributes carry what the run shares.
+// The plain draw only needs the palette and declares no storage block.
+layout (location = 3) in uint aPalette;
 
 uniform mat4 projection;
 uniform mat4 view;
 
-out float velocity_magnitude;
+#if FUSED_UPDATE
+struct ParticleGroup {
+    uint offset;
+    uint count;
+    uint first_work_group;
+    uint palette;
+    float attraction;   // Already divided by the mass
+    float damping;
+    float inv_mass;
+    uint species;
+};
+
+layout(std430, binding = 5) readonly buffer GroupTable {
+    ParticleGroup groups[];
+};
+#endif
+
+#if PARTICLE_FLAGS
+layout(std430, binding = 9) readonly buffer ParticleFlags {
+    uint flags[];
+};
+
+#define FLAG_FROZEN 1u
+#define FLAG_DELETED 2u
+#define FLAG_PALETTE_SHIFT 2u
+#endif
+
+// Baked velocity-to-color LUT, one row per palette
+uniform sampler2D colormap;
+uniform float colormap_rows;
+uniform float max_velocity;
+
+flat out vec3 particle_color;
+
+#define COLORMAP_RESOLUTION 256.0
+
+#if FUSED_UPDATE
+// Same step as particle.comp without the fluid drag
+vec2 mouse_force(vec2 position, float attraction) {
+    vec2 to_mouse = mouse_pos - position;
+    float length_sq = dot(to_mouse, to_mouse);
+    bool in_reach = force_radius <= 0.0 || length_sq < force_radius * force_radius;
+    // Same floor as SIMD_NORMALIZE_EPSILON, normalize() is NaN at the mouse
+    return in_reach ? to_mouse * (attraction * inversesqrt(max(length_sq, 1e-12))) : vec2(0.0);
+}
+
+void step_particle(inout vec2 position, inout vec2 velocity, ParticleGroup group) {
+#if INTEGRATOR == INTEGRATOR_SYMPLECTIC_EULER
+    velocity += mouse_force(position, group.attraction) * delta_time;
+    velocity *= group.damping;
+    position += velocity * delta_time;
+#else
+    position += velocity * delta_time;
+    velocity += mouse_force(position, group.attraction) * delta_time;
+    velocity *= group.damping;
+#endif
+}
+#endif
 
 void main() {
-    gl_Position = projection * view * vec4(aPos, 0.0, 1.0);
+    // gl_VertexID includes the draw's first, so it indexes the pool
+    uint index = uint(gl_VertexID);
+    uint palette = aPalette;
+#if PARTICLE_FLAGS
+    uint state = (flags[index >> 2] >> ((index & 3u) * 8u)) & 0xFFu;
+    uint override_palette = state >> FLAG_PALETTE_SHIFT;
+    palette = override_palette != 0u ? override_palette - 1u : palette;
+#endif
+
+#if FUSED_UPDATE
+    // Assumes one invocation per vertex. GL doesn't promise that, it may
+    // shade a vertex again, which would step that particle twice. Drivers
+    // shade non-indexed points once; --bench-fused checks it with a vertex
+    // shader invocation count.
+    vec2 position = positions[index];
+    vec2 velocity = velocities[index];
+#if PARTICLE_FLAGS
+    bool held = (state & (FLAG_FROZEN | FLAG_DELETED)) != 0u;
+#else
+    bool held = false;
+#endif
+    if (held) {
+        velocity = vec2(0.0);
+    } else {
+        step_particle(position, velocity, groups[aDrawIndex]);
+    }
+    positions[index] = position;
+    velocities[index] = velocity;
+    float speed = length(velocity);
+#else
+    vec2 position = aPos;
+    float speed = aVelocityMag;
+#endif
+
+    gl_Position = projection * view * vec4(position, 0.0, 1.0);
     gl_PointSize = 2.0;
-    
-    velocity_magnitude = aVelocityMag;
-}
\ No newline at end of file
+#if PARTICLE_FLAGS
+    // Outside the clip volume, the point is dropped before rasterization
+    if ((state & FLAG_DELETED) != 0u) {
+        gl_Position = vec4(2.0, 2.0, 2.0, 1.0);
+    }
+#endif
+
+    // Map to texel centers so 0 and max hit the first and last entries
+    float normalized = clamp(speed / max_velocity, 0.0, 1.0);
+    float u = (0.5 + normalized * (COLORMAP_RESOLUTION - 1.0)) / COLORMAP_RESOLUTION;
+    float row = (float(palette) + 0.5) / colormap_rows;
+    particle_color = textureLod(colormap, vec2(u, row), 0.0).rgb;
+}
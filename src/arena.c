@@ -0,0 +1,86 @@
+#include "arena.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include "job_system.h"
+
+// Pages touched per job when prefaulting
+#define ARENA_PREFAULT_GRAIN 256
+
+typedef struct {
+    unsigned char* begin;
+    size_t stride;
+} PrefaultJob;
+
+static size_t round_up(size_t value, size_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+bool arena_init(Arena* arena, size_t capacity, unsigned int flags) {
+    memset(arena, 0, sizeof(*arena));
+
+    // Whole huge pages either way, so the block can switch backing freely
+    arena->capacity = round_up(capacity > 0 ? capacity : 1, platform_huge_page_size());
+    arena->base = (unsigned char*)platform_alloc_pages(arena->capacity, (flags & ARENA_HUGE_PAGES) != 0,
+                                                       &arena->pageKind);
+    if (!arena->base) {
+        fprintf(stderr, "Failed to map %zu byte arena\n", arena->capacity);
+        arena->capacity = 0;
+        return false;
+    }
+
+    if (flags & ARENA_PREFAULT) {
+        arena_prefault(arena, 0, arena->capacity);
+    }
+    return true;
+}
+
+void* arena_alloc(Arena* arena, size_t size) {
+    size_t offset = round_up(arena->used, ARENA_ALIGNMENT);
+    if (!arena->base || size > arena->capacity || offset > arena->capacity - size) {
+        return NULL;
+    }
+    arena->used = offset + size;
+    return arena->base + offset;
+}
+
+void arena_reset(Arena* arena) {
+    arena->used = 0;
+}
+
+static void prefault_pages(void* data, int begin, int end) {
+    PrefaultJob* job = (PrefaultJob*)data;
+    for (int page = begin; page < end; page++) {
+        // The mapping is already zero, writing zero only forces the fault
+        ((volatile unsigned char*)job->begin)[(size_t)page * job->stride] = 0;
+    }
+}
+
+void arena_prefault(Arena* arena, size_t offset, size_t size) {
+    if (!arena->base || offset >= arena->capacity) {
+        return;
+    }
+    if (size > arena->capacity - offset) {
+        size = arena->capacity - offset;
+    }
+
+    // A transparent huge page may still come back as small pages, so touch every small page
+    PrefaultJob job;
+    job.stride = arena->pageKind == PLATFORM_PAGES_HUGE ? platform_huge_page_size() : platform_page_size();
+    job.begin = arena->base + offset / job.stride * job.stride;
+    int pages = (int)((arena->base + offset + size - job.begin + job.stride - 1) / job.stride);
+    job_parallel_for(0, pages, ARENA_PREFAULT_GRAIN, prefault_pages, &job);
+}
+
+void arena_release(Arena* arena) {
+    platform_free_pages(arena->base, arena->capacity);
+    memset(arena, 0, sizeof(*arena));
+}
+
+const char* arena_page_kind_name(PlatformPageKind kind) {
+    switch (kind) {
+        case PLATFORM_PAGES_HUGE: return "huge pages";
+        case PLATFORM_PAGES_TRANSPARENT_HUGE: return "transparent huge pages";
+        default: return "small pages";
+    }
+}
@@ -0,0 +1,109 @@
+#include "budget.h"
+
+#define BUDGET_DEFAULT_HYSTERESIS 0.10f
+#define BUDGET_DEFAULT_MAX_GROWTH 1.25f
+#define BUDGET_DEFAULT_COOLDOWN 8
+#define BUDGET_DEFAULT_SMOOTHING 0.2f
+#define BUDGET_MIN_SAMPLES 4
+
+// Headroom applied when shrinking so we land just inside the band
+#define BUDGET_SHRINK_MARGIN 0.95f
+
+static int clamp_count(ParticleBudget* budget, double count) {
+    if (count < budget->minCount) count = budget->minCount;
+    if (count > budget->maxCount) count = budget->maxCount;
+
+    int result = (int)count;
+    if (budget->granularity > 1) {
+        result = (result / budget->granularity) * budget->granularity;
+        if (result < budget->minCount) result = budget->minCount;
+    }
+    return result;
+}
+
+void budget_init(ParticleBudget* budget, float targetMs, int minCount, int maxCount, int granularity) {
+    budget->enabled = false;
+    budget->targetMs = targetMs;
+    budget->hysteresis = BUDGET_DEFAULT_HYSTERESIS;
+    budget->maxGrowth = BUDGET_DEFAULT_MAX_GROWTH;
+    budget->minCount = minCount;
+    budget->maxCount = maxCount;
+    budget->granularity = granularity;
+    budget->cooldownFrames = BUDGET_DEFAULT_COOLDOWN;
+    budget->cooldown = 0;
+    budget->stepMs = 0.0f;
+    budget->drawMs = 0.0f;
+    budget->smoothing = BUDGET_DEFAULT_SMOOTHING;
+    budget->samples = 0;
+    budget->decision = BUDGET_HOLD;
+    budget->lastCount = maxCount;
+}
+
+int budget_update(ParticleBudget* budget, float stepMs, float drawMs, int currentCount) {
+    // Count changed behind our back (UI, reset...), restart measurements
+    if (currentCount != budget->lastCount) {
+        budget->samples = 0;
+        budget->lastCount = currentCount;
+    }
+
+    if (budget->samples == 0) {
+        budget->stepMs = stepMs;
+        budget->drawMs = drawMs;
+    } else {
+        budget->stepMs += (stepMs - budget->stepMs) * budget->smoothing;
+        budget->drawMs += (drawMs - budget->drawMs) * budget->smoothing;
+    }
+    budget->samples++;
+
+    if (!budget->enabled) {
+        budget->decision = BUDGET_HOLD;
+        return currentCount;
+    }
+
+    // Timer results lag a few frames, don't react to stale numbers
+    if (budget->cooldown > 0) {
+        budget->cooldown--;
+        budget->samples = 0;
+        return currentCount;
+    }
+    if (budget->samples < BUDGET_MIN_SAMPLES) {
+        return currentCount;
+    }
+
+    float measured = budget->stepMs + budget->drawMs;
+    float upper = budget->targetMs * (1.0f + budget->hysteresis);
+    float lower = budget->targetMs * (1.0f - budget->hysteresis);
+
+    // Step and draw are both linear in particle count, so scale proportionally
+    double newCount = currentCount;
+    if (measured > upper) {
+        budget->decision = BUDGET_SHRINK;
+        newCount = (double)currentCount * (budget->targetMs / measured) * BUDGET_SHRINK_MARGIN;
+    } else if (measured < lower && currentCount < budget->maxCount) {
+        budget->decision = BUDGET_GROW;
+        float ratio = measured > 0.0f ? budget->targetMs / measured : budget->maxGrowth;
+        if (ratio > budget->maxGrowth) ratio = budget->maxGrowth;
+        newCount = (double)currentCount * ratio;
+    } else {
+        budget->decision = BUDGET_HOLD;
+        return currentCount;
+    }
+
+    int result = clamp_count(budget, newCount);
+    if (result != currentCount) {
+        budget->cooldown = budget->cooldownFrames;
+        budget->samples = 0;
+        budget->lastCount = result;
+    } else {
+        budget->decision = BUDGET_HOLD;
+    }
+    return result;
+}
+
+const char* budget_decision_name(BudgetDecision decision) {
+    switch (decision) {
+        case BUDGET_GROW:   return "Grow";
+        case BUDGET_SHRINK: return "Shrink";
+        default:            return "Hold";
+    }
+}
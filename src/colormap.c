@@ -0,0 +1,156 @@
+#include "colormap.h"
+#include <math.h>
+
+typedef struct {
+    float t;
+    float rgb[3];
+} ColorStop;
+
+// Miami Vice inspired color palette
+static const ColorStop miamiStops[] = {
+    {0.0f, {0.0f, 0.8f, 0.8f}},    // Cyan/Turquoise
+    {0.4f, {0.9f, 0.0f, 0.9f}},    // Hot Pink/Magenta
+    {0.7f, {0.98f, 0.2f, 0.85f}},  // Electric Pink
+    {1.0f, {0.98f, 0.2f, 0.85f}},
+};
+
+static const ColorStop infernoStops[] = {
+    {0.0f, {0.00f, 0.00f, 0.02f}},
+    {0.25f, {0.34f, 0.06f, 0.43f}},
+    {0.5f, {0.73f, 0.21f, 0.33f}},
+    {0.75f, {0.98f, 0.55f, 0.04f}},
+    {1.0f, {0.99f, 1.00f, 0.64f}},
+};
+
+static const ColorStop viridisStops[] = {
+    {0.0f, {0.27f, 0.00f, 0.33f}},
+    {0.25f, {0.23f, 0.32f, 0.55f}},
+    {0.5f, {0.13f, 0.57f, 0.55f}},
+    {0.75f, {0.37f, 0.79f, 0.38f}},
+    {1.0f, {0.99f, 0.91f, 0.14f}},
+};
+
+static const ColorStop grayscaleStops[] = {
+    {0.0f, {0.15f, 0.15f, 0.15f}},
+    {1.0f, {1.0f, 1.0f, 1.0f}},
+};
+
+static const char* paletteNames[COLORMAP_COUNT] = {
+    "Miami", "Inferno", "Viridis", "Rainbow", "Grayscale"
+};
+
+static void sample_stops(const ColorStop* stops, int count, float t, float* rgb) {
+    for (int i = 1; i < count; i++) {
+        if (t <= stops[i].t || i == count - 1) {
+            float span = stops[i].t - stops[i - 1].t;
+            float f = span > 0.0f ? (t - stops[i - 1].t) / span : 0.0f;
+            if (f < 0.0f) f = 0.0f;
+            if (f > 1.0f) f = 1.0f;
+            for (int c = 0; c < 3; c++) {
+                rgb[c] = stops[i - 1].rgb[c] + (stops[i].rgb[c] - stops[i - 1].rgb[c]) * f;
+            }
+            return;
+        }
+    }
+}
+
+static void hsv2rgb(float h, float s, float v, float* rgb) {
+    static const float K[4] = {1.0f, 2.0f / 3.0f, 1.0f / 3.0f, 3.0f};
+    for (int c = 0; c < 3; c++) {
+        float x = h + K[c];
+        float p = fabsf((x - floorf(x)) * 6.0f - K[3]);
+        float k = p - K[0];
+        if (k < 0.0f) k = 0.0f;
+        if (k > 1.0f) k = 1.0f;
+        rgb[c] = v * (K[0] + (k - K[0]) * s);
+    }
+}
+
+// Logarithmic compression of normalized velocity, formerly done per fragment
+static float velocity_transfer(float normalized) {
+    float log_normalized = 1.0f - logf(1.0f + (1.0f - normalized) * 19.0f) / logf(20.0f);
+    return powf(log_normalized, 0.7f);
+}
+
+static void palette_color(int palette, float t, float* rgb) {
+    switch (palette) {
+        case COLORMAP_INFERNO:
+            sample_stops(infernoStops, 5, t, rgb);
+            break;
+        case COLORMAP_VIRIDIS:
+            sample_stops(viridisStops, 5, t, rgb);
+            break;
+        case COLORMAP_RAINBOW:
+            hsv2rgb(0.66f * (1.0f - t), 0.9f, 1.0f, rgb);
+            break;
+        case COLORMAP_GRAYSCALE:
+            sample_stops(grayscaleStops, 2, t, rgb);
+            break;
+        default:
+            sample_stops(miamiStops, 4, t, rgb);
+            break;
+    }
+
+    // Enhanced glow effect
+    float brightness = 0.85f + t * 0.35f;
+    for (int c = 0; c < 3; c++) {
+        float color = rgb[c] * brightness;
+        color = color + (1.0f - color) * t * 0.2f;
+        rgb[c] = color > 1.0f ? 1.0f : color;
+    }
+}
+
+void colormap_init(Colormap* colormap) {
+    static unsigned char texels[COLORMAP_COUNT][COLORMAP_RESOLUTION][4];
+
+    for (int p = 0; p < COLORMAP_COUNT; p++) {
+        for (int i = 0; i < COLORMAP_RESOLUTION; i++) {
+            float normalized = (float)i / (COLORMAP_RESOLUTION - 1);
+            float rgb[3];
+            palette_color(p, velocity_transfer(normalized), rgb);
+            texels[p][i][0] = (unsigned char)(rgb[0] * 255.0f + 0.5f);
+            texels[p][i][1] = (unsigned char)(rgb[1] * 255.0f + 0.5f);
+            texels[p][i][2] = (unsigned char)(rgb[2] * 255.0f + 0.5f);
+            texels[p][i][3] = 255;
+        }
+    }
+
+    // One row per palette, filtered along velocity only
+    glGenTextures(1, &colormap->texture);
+    glBindTexture(GL_TEXTURE_2D, colormap->texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, COLORMAP_RESOLUTION, COLORMAP_COUNT, 0,
+                 GL_RGBA, GL_UNSIGNED_BYTE, texels);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    colormap->palette = COLORMAP_MIAMI;
+}
+
+void colormap_bind(Colormap* colormap, unsigned int program, int unit) {
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(GL_TEXTURE_2D, colormap->texture);
+    glUniform1i(glGetUniformLocation(program, "colormap"), unit);
+    glUniform1f(glGetUniformLocation(program, "colormap_rows"), (float)COLORMAP_COUNT);
+    glUniform1f(glGetUniformLocation(program, "max_velocity"), COLORMAP_MAX_VELOCITY);
+}
+
+void colormap_set_palette(Colormap* colormap, int palette) {
+    if (palette < 0 || palette >= COLORMAP_COUNT) {
+        palette = COLORMAP_MIAMI;
+    }
+    colormap->palette = palette;
+}
+
+const char* colormap_palette_name(int palette) {
+    if (palette < 0 || palette >= COLORMAP_COUNT) {
+        return "Unknown";
+    }
+    return paletteNames[palette];
+}
+
+void colormap_cleanup(Colormap* colormap) {
+    glDeleteTextures(1, &colormap->texture);
+}
@@ -0,0 +1,108 @@
+#include "cpu_features.h"
+#include <string.h>
+
+#if defined(__GNUC__) || defined(__clang__)
+#include <cpuid.h>
+#elif defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+static const char* isaNames[SIMD_ISA_COUNT] = { "sse2", "avx2", "avx512" };
+
+static void cpuid(unsigned int leaf, unsigned int subleaf, unsigned int regs[4]) {
+#if defined(__GNUC__) || defined(__clang__)
+    __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#elif defined(_MSC_VER)
+    int info[4];
+    __cpuidex(info, (int)leaf, (int)subleaf);
+    for (int i = 0; i < 4; i++) regs[i] = (unsigned int)info[i];
+#else
+    regs[0] = regs[1] = regs[2] = regs[3] = 0;
+#endif
+}
+
+// Register state the OS saves on context switch (XCR0)
+static unsigned long long xgetbv0(void) {
+#if defined(__GNUC__) || defined(__clang__)
+    unsigned int eax, edx;
+    __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return ((unsigned long long)edx << 32) | eax;
+#elif defined(_MSC_VER)
+    return _xgetbv(0);
+#else
+    return 0;
+#endif
+}
+
+static CpuFeatures detect_features(void) {
+    CpuFeatures features;
+    memset(&features, 0, sizeof(features));
+
+    unsigned int regs[4];
+    cpuid(0, 0, regs);
+    unsigned int maxLeaf = regs[0];
+
+    cpuid(1, 0, regs);
+    features.sse2 = (regs[3] >> 26) & 1;
+    bool osxsave = (regs[2] >> 27) & 1;
+    bool avx = (regs[2] >> 28) & 1;
+    bool fma = (regs[2] >> 12) & 1;
+
+    if (!osxsave || maxLeaf < 7) {
+        return features;
+    }
+
+    unsigned long long xcr0 = xgetbv0();
+    bool ymmState = (xcr0 & 0x6) == 0x6;     // SSE + AVX
+    bool zmmState = (xcr0 & 0xE6) == 0xE6;   // + opmask, ZMM hi256, hi16 ZMM
+
+    cpuid(7, 0, regs);
+    bool avx2 = (regs[1] >> 5) & 1;
+    bool avx512f = (regs[1] >> 16) & 1;
+
+    features.avx2 = avx && avx2 && fma && ymmState;
+    features.avx512 = features.avx2 && avx512f && zmmState;
+    return features;
+}
+
+const CpuFeatures* cpu_features(void) {
+    static CpuFeatures features;
+    static bool detected = false;
+    if (!detected) {
+        features = detect_features();
+        detected = true;
+    }
+    return &features;
+}
+
+bool cpu_supports(SimdIsa isa) {
+    const CpuFeatures* features = cpu_features();
+    switch (isa) {
+        case SIMD_ISA_SSE2:   return features->sse2;
+        case SIMD_ISA_AVX2:   return features->avx2;
+        case SIMD_ISA_AVX512: return features->avx512;
+        default:              return false;
+    }
+}
+
+SimdIsa cpu_best_isa(void) {
+    if (cpu_supports(SIMD_ISA_AVX512)) return SIMD_ISA_AVX512;
+    if (cpu_supports(SIMD_ISA_AVX2)) return SIMD_ISA_AVX2;
+    return SIMD_ISA_SSE2;
+}
+
+const char* simd_isa_name(SimdIsa isa) {
+    if (isa < 0 || isa >= SIMD_ISA_COUNT) {
+        return "unknown";
+    }
+    return isaNames[isa];
+}
+
+int simd_isa_from_name(const char* name) {
+    for (int i = 0; i < SIMD_ISA_COUNT; i++) {
+        if (strcmp(name, isaNames[i]) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
@@ -0,0 +1,263 @@
+#include "cpu_sim.h"
+#include <stdio.h>
+#include <string.h>
+
+// integrate reads position + velocity and writes them back with the speed
+#define CPU_SIM_BYTES_PER_PARTICLE (4 * sizeof(float) + 5 * sizeof(float))
+// Worker ranges stay whole cache lines of every array
+#define CPU_SIM_RANGE_ALIGNMENT 16
+#define CPU_SIM_WARMUP_STEPS 3
+
+enum {
+    CPU_SIM_INIT,
+    CPU_SIM_STEP,
+    CPU_SIM_QUIT
+};
+
+static size_t round_up(size_t value, size_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+static void run_worker_command(CpuSimWorker* worker, int command) {
+    CpuSim* sim = worker->sim;
+    int count = worker->end - worker->begin;
+    if (count <= 0) {
+        return;
+    }
+
+    if (command == CPU_SIM_INIT) {
+        // First touch from the owning node places these pages locally
+        const float center[2] = {0.0f, 0.0f};
+        sim->kernels->init_positions(sim->positions + worker->begin, count, center, 20.0f,
+                                     (uint32_t)worker->begin + 1);
+        sim->kernels->zero_velocities(sim->velocities + worker->begin, count);
+        memset(sim->speeds + worker->begin, 0, count * sizeof(float));
+    } else {
+        sim->kernels->integrate(sim->positions + worker->begin, sim->velocities + worker->begin,
+                                sim->speeds + worker->begin, count, &sim->params);
+    }
+}
+
+static void worker_main(void* arg) {
+    CpuSimWorker* worker = (CpuSimWorker*)arg;
+    CpuSim* sim = worker->sim;
+    worker->pinned = platform_thread_pin(worker->cpu);
+
+    unsigned int seen = 0;
+    for (;;) {
+        platform_mutex_lock(&sim->mutex);
+        while (sim->generation == seen) {
+            platform_cond_wait(&sim->start, &sim->mutex);
+        }
+        seen = sim->generation;
+        int command = sim->command;
+        platform_mutex_unlock(&sim->mutex);
+
+        if (command == CPU_SIM_QUIT) {
+            break;
+        }
+
+        double start = platform_time_seconds();
+        run_worker_command(worker, command);
+        worker->seconds = platform_time_seconds() - start;
+
+        platform_mutex_lock(&sim->mutex);
+        if (--sim->remaining == 0) {
+            platform_cond_signal(&sim->done);
+        }
+        platform_mutex_unlock(&sim->mutex);
+    }
+}
+
+// Broadcast a command to every worker and wait until all have finished it
+static void run_command(CpuSim* sim, int command) {
+    platform_mutex_lock(&sim->mutex);
+    sim->command = command;
+    sim->remaining = sim->workerCount;
+    sim->generation++;
+    platform_cond_broadcast(&sim->start);
+    while (command != CPU_SIM_QUIT && sim->remaining > 0) {
+        platform_cond_wait(&sim->done, &sim->mutex);
+    }
+    platform_mutex_unlock(&sim->mutex);
+
+    for (int n = 0; n < sim->nodeCount; n++) {
+        CpuSimNode* node = &sim->nodes[n];
+        node->seconds = 0.0;
+        for (int w = node->firstWorker; w < node->firstWorker + node->workerCount; w++) {
+            if (sim->workers[w].seconds > node->seconds) {
+                node->seconds = sim->workers[w].seconds;
+            }
+        }
+    }
+}
+
+// Node shares follow each node's CPU count. Boundaries fall on huge pages of
+// every array, so no page is shared between two nodes.
+static void partition(CpuSim* sim, int cpus[][CPU_SIM_MAX_THREADS], const int* cpuCounts) {
+    int totalCpus = 0;
+    for (int n = 0; n < sim->nodeCount; n++) {
+        totalCpus += cpuCounts[n];
+    }
+
+    int granule = (int)(platform_huge_page_size() / sizeof(float));
+    int cumulative = 0;
+    int begin = 0;
+    sim->workerCount = 0;
+    for (int n = 0; n < sim->nodeCount; n++) {
+        CpuSimNode* node = &sim->nodes[n];
+        cumulative += cpuCounts[n];
+        int end = sim->count;
+        if (n < sim->nodeCount - 1) {
+            end = (int)((long long)sim->count * cumulative / totalCpus / granule * granule);
+            end = end < begin ? begin : end;
+        }
+        node->begin = begin;
+        node->end = end;
+        node->firstWorker = sim->workerCount;
+        node->workerCount = cpuCounts[n];
+
+        int share = end - begin;
+        for (int i = 0; i < cpuCounts[n]; i++) {
+            CpuSimWorker* worker = &sim->workers[sim->workerCount++];
+            worker->sim = sim;
+            worker->node = n;
+            worker->cpu = cpus[n][i];
+            int first = (int)((long long)share * i / cpuCounts[n]);
+            int last = (int)((long long)share * (i + 1) / cpuCounts[n]);
+            worker->begin = begin + first / CPU_SIM_RANGE_ALIGNMENT * CPU_SIM_RANGE_ALIGNMENT;
+            worker->end = i == cpuCounts[n] - 1 ? end
+                                                : begin + last / CPU_SIM_RANGE_ALIGNMENT * CPU_SIM_RANGE_ALIGNMENT;
+        }
+        begin = end;
+    }
+}
+
+bool cpu_sim_init(CpuSim* sim, int count, int maxNodes) {
+    memset(sim, 0, sizeof(*sim));
+    sim->count = count;
+    sim->kernels = simd_get();
+
+    static int cpus[PLATFORM_MAX_NUMA_NODES][CPU_SIM_MAX_THREADS];
+    int cpuCounts[PLATFORM_MAX_NUMA_NODES];
+    int available = platform_numa_node_count();
+    sim->nodeCount = maxNodes > 0 && maxNodes < available ? maxNodes : available;
+    int threads = 0;
+    for (int n = 0; n < sim->nodeCount; n++) {
+        cpuCounts[n] = platform_numa_node_cpus(n, cpus[n], CPU_SIM_MAX_THREADS - threads);
+        threads += cpuCounts[n];
+    }
+    // Memory-only nodes have no CPUs to run on
+    while (sim->nodeCount > 1 && cpuCounts[sim->nodeCount - 1] == 0) {
+        sim->nodeCount--;
+    }
+    if (threads == 0) {
+        fprintf(stderr, "No CPUs found for the CPU simulation\n");
+        return false;
+    }
+    partition(sim, cpus, cpuCounts);
+
+    // Reserve only, pages are placed by the first touch in CPU_SIM_INIT
+    size_t hugePage = platform_huge_page_size();
+    size_t vecBytes = round_up((size_t)count * sizeof(vec2), hugePage);
+    size_t floatBytes = round_up((size_t)count * sizeof(float), hugePage);
+    if (!arena_init(&sim->arena, 2 * vecBytes + floatBytes + hugePage, ARENA_HUGE_PAGES)) {
+        return false;
+    }
+    sim->positions = (vec2*)arena_alloc(&sim->arena, vecBytes);
+    sim->velocities = (vec2*)arena_alloc(&sim->arena, vecBytes);
+    sim->speeds = (float*)arena_alloc(&sim->arena, floatBytes);
+
+    platform_mutex_init(&sim->mutex);
+    platform_cond_init(&sim->start);
+    platform_cond_init(&sim->done);
+    for (int i = 0; i < sim->workerCount; i++) {
+        if (!platform_thread_create(&sim->workers[i].thread, worker_main, &sim->workers[i])) {
+            fprintf(stderr, "Failed to start CPU simulation worker %d\n", i);
+            sim->workerCount = i;
+            cpu_sim_shutdown(sim);
+            return false;
+        }
+    }
+
+    double start = platform_time_seconds();
+    run_command(sim, CPU_SIM_INIT);
+    sim->initSeconds = platform_time_seconds() - start;
+    return true;
+}
+
+void cpu_sim_step(CpuSim* sim, const SimdIntegrateParams* params) {
+    sim->params = *params;
+    run_command(sim, CPU_SIM_STEP);
+}
+
+void cpu_sim_shutdown(CpuSim* sim) {
+    run_command(sim, CPU_SIM_QUIT);
+    for (int i = 0; i < sim->workerCount; i++) {
+        platform_thread_join(&sim->workers[i].thread);
+    }
+    platform_cond_destroy(&sim->done);
+    platform_cond_destroy(&sim->start);
+    platform_mutex_destroy(&sim->mutex);
+    arena_release(&sim->arena);
+}
+
+// Average step time over CPU_SIM_BENCH_STEPS, per node and overall
+static double benchmark_run(int particleCount, int maxNodes) {
+    CpuSim sim;
+    if (!cpu_sim_init(&sim, particleCount, maxNodes)) {
+        return 0.0;
+    }
+
+    int pinned = 0;
+    for (int i = 0; i < sim.workerCount; i++) {
+        pinned += sim.workers[i].pinned ? 1 : 0;
+    }
+    size_t touched = (size_t)particleCount * (2 * sizeof(vec2) + sizeof(float));
+    printf("%d node%s, %d threads (%d pinned), %s\n", sim.nodeCount, sim.nodeCount == 1 ? "" : "s",
+           sim.workerCount, pinned, arena_page_kind_name(sim.arena.pageKind));
+    printf("  first touch %8.2f ms %8.1f GB/s\n", sim.initSeconds * 1000.0,
+           sim.initSeconds > 0.0 ? touched / sim.initSeconds / 1e9 : 0.0);
+
+    SimdIntegrateParams params = { {0.0f, 0.0f}, 2.5f, 0.9998f, 1.0f / 60.0f };
+    for (int i = 0; i < CPU_SIM_WARMUP_STEPS; i++) {
+        cpu_sim_step(&sim, &params);
+    }
+
+    double nodeSeconds[PLATFORM_MAX_NUMA_NODES] = {0.0};
+    double start = platform_time_seconds();
+    for (int i = 0; i < CPU_SIM_BENCH_STEPS; i++) {
+        cpu_sim_step(&sim, &params);
+        for (int n = 0; n < sim.nodeCount; n++) {
+            nodeSeconds[n] += sim.nodes[n].seconds;
+        }
+    }
+    double step = (platform_time_seconds() - start) / CPU_SIM_BENCH_STEPS;
+
+    for (int n = 0; n < sim.nodeCount; n++) {
+        const CpuSimNode* node = &sim.nodes[n];
+        double seconds = nodeSeconds[n] / CPU_SIM_BENCH_STEPS;
+        int count = node->end - node->begin;
+        printf("  node %d %3d threads %10d particles %8.2f ms %8.1f GB/s\n", n, node->workerCount, count,
+               seconds * 1000.0, seconds > 0.0 ? count * (double)CPU_SIM_BYTES_PER_PARTICLE / seconds / 1e9 : 0.0);
+    }
+    printf("  step        %8.2f ms %8.1f GB/s\n", step * 1000.0,
+           particleCount * (double)CPU_SIM_BYTES_PER_PARTICLE / step / 1e9);
+
+    cpu_sim_shutdown(&sim);
+    return step;
+}
+
+void cpu_sim_benchmark(int particleCount) {
+    int nodes = platform_numa_node_count();
+    printf("CPU simulation benchmark, %d particles, %d steps, %s kernels\n", particleCount, CPU_SIM_BENCH_STEPS,
+           simd_isa_name(simd_get()->isa));
+
+    double single = benchmark_run(particleCount, 1);
+    if (nodes > 1) {
+        double all = benchmark_run(particleCount, 0);
+        if (single > 0.0 && all > 0.0) {
+            printf("Scaling over %d nodes: %.2fx\n", nodes, single / all);
+        }
+    }
+}
@@ -0,0 +1,388 @@
+#include "fluid.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "simd_kernels.h"
+#include "job_system.h"
+#include "platform.h"
+
+// Rows handed to one job, the grid is small so keep the per-job work meaningful
+#define FLUID_ROW_GRAIN 16
+#define FLUID_DEFAULT_DISSIPATION 0.5f
+#define FLUID_DEFAULT_COUPLING 4.0f
+#define FLUID_DEFAULT_SPLAT_RADIUS 1.0f
+
+#define IX(fluid, x, y) ((y) * ((fluid)->size + 2) + (x))
+
+static int fluid_cells(const FluidField* fluid) {
+    return (fluid->size + 2) * (fluid->size + 2);
+}
+
+static unsigned int create_field_texture(GLenum format, int size, const float* zeros, int components) {
+    unsigned int texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexStorage2D(GL_TEXTURE_2D, 1, format, size, size);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, size, size, components == 2 ? GL_RG : GL_RED, GL_FLOAT, zeros);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    return texture;
+}
+
+void fluid_init(FluidField* fluid, float extent, int size) {
+    memset(fluid, 0, sizeof(*fluid));
+    fluid->enabled = false;
+    fluid->solver = FLUID_SOLVER_CPU;
+    fluid->activeSolver = FLUID_SOLVER_CPU;
+    fluid->size = size;
+    fluid->extent = extent;
+    fluid->cellSize = 2.0f * extent / size;
+    fluid->dissipation = FLUID_DEFAULT_DISSIPATION;
+    fluid->coupling = FLUID_DEFAULT_COUPLING;
+    fluid->splatRadius = FLUID_DEFAULT_SPLAT_RADIUS;
+    fluid->pressureIterations = FLUID_PRESSURE_ITERATIONS;
+
+    int cells = fluid_cells(fluid);
+    float** fields[] = { &fluid->u, &fluid->v, &fluid->u0, &fluid->v0,
+                         &fluid->pressure, &fluid->pressure0, &fluid->divergence };
+    for (int i = 0; i < (int)(sizeof(fields) / sizeof(fields[0])); i++) {
+        *fields[i] = (float*)calloc(cells, sizeof(float));
+    }
+    fluid->upload = (float*)calloc(cells * 2, sizeof(float));
+
+    if (!fluid->u || !fluid->v || !fluid->u0 || !fluid->v0 || !fluid->pressure ||
+        !fluid->pressure0 || !fluid->divergence || !fluid->upload) {
+        fprintf(stderr, "Failed to allocate fluid grid\n");
+        fluid_cleanup(fluid);
+        return;
+    }
+
+    int dim = size + 2;
+    for (int i = 0; i < 2; i++) {
+        fluid->velocityTextures[i] = create_field_texture(GL_RG32F, dim, fluid->upload, 2);
+        fluid->pressureTextures[i] = create_field_texture(GL_R32F, dim, fluid->upload, 1);
+    }
+    fluid->divergenceTexture = create_field_texture(GL_R32F, dim, fluid->upload, 1);
+    fluid->current = 0;
+
+    // Stage programs are compiled the first time the GPU solver runs
+    const char* path = "shaders/fluid.comp";
+    GLenum type = GL_COMPUTE_SHADER;
+    shader_variant_cache_init(&fluid->stages, "Fluid", &path, &type, 1);
+}
+
+void fluid_set_mouse(FluidField* fluid, float x, float y, bool dragging) {
+    fluid->mousePos[0] = x;
+    fluid->mousePos[1] = y;
+    fluid->dragging = dragging;
+}
+
+void fluid_reset(FluidField* fluid) {
+    if (!fluid->u) {
+        return;
+    }
+
+    int cells = fluid_cells(fluid);
+    memset(fluid->u, 0, cells * sizeof(float));
+    memset(fluid->v, 0, cells * sizeof(float));
+    memset(fluid->pressure, 0, cells * sizeof(float));
+    memset(fluid->upload, 0, cells * 2 * sizeof(float));
+
+    int dim = fluid->size + 2;
+    for (int i = 0; i < 2; i++) {
+        glBindTexture(GL_TEXTURE_2D, fluid->velocityTextures[i]);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, dim, dim, GL_RG, GL_FLOAT, fluid->upload);
+        glBindTexture(GL_TEXTURE_2D, fluid->pressureTextures[i]);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, dim, dim, GL_RED, GL_FLOAT, fluid->upload);
+    }
+}
+
+// World position to continuous cell index, interior cell centers are 1..size
+static void world_to_cell(const FluidField* fluid, const float* world, float* cell) {
+    cell[0] = (world[0] + fluid->extent) / fluid->cellSize + 0.5f;
+    cell[1] = (world[1] + fluid->extent) / fluid->cellSize + 0.5f;
+}
+
+// CPU solver
+
+// Walls: the normal component is mirrored (b = 1 for u, 2 for v), scalars are copied
+static void set_boundary(const FluidField* fluid, int b, float* x) {
+    int n = fluid->size;
+    for (int i = 1; i <= n; i++) {
+        x[IX(fluid, 0, i)] = b == 1 ? -x[IX(fluid, 1, i)] : x[IX(fluid, 1, i)];
+        x[IX(fluid, n + 1, i)] = b == 1 ? -x[IX(fluid, n, i)] : x[IX(fluid, n, i)];
+        x[IX(fluid, i, 0)] = b == 2 ? -x[IX(fluid, i, 1)] : x[IX(fluid, i, 1)];
+        x[IX(fluid, i, n + 1)] = b == 2 ? -x[IX(fluid, i, n)] : x[IX(fluid, i, n)];
+    }
+    x[IX(fluid, 0, 0)] = 0.5f * (x[IX(fluid, 1, 0)] + x[IX(fluid, 0, 1)]);
+    x[IX(fluid, 0, n + 1)] = 0.5f * (x[IX(fluid, 1, n + 1)] + x[IX(fluid, 0, n)]);
+    x[IX(fluid, n + 1, 0)] = 0.5f * (x[IX(fluid, n, 0)] + x[IX(fluid, n + 1, 1)]);
+    x[IX(fluid, n + 1, n + 1)] = 0.5f * (x[IX(fluid, n, n + 1)] + x[IX(fluid, n + 1, n)]);
+}
+
+// Blend the velocity under the cursor toward the drag velocity
+static void splat_cpu(FluidField* fluid, const float* center, const float* velocity) {
+    float radius = fluid->splatRadius / fluid->cellSize;
+    int reach = (int)ceilf(radius * 3.0f);
+    int x0 = (int)center[0] - reach, x1 = (int)center[0] + reach;
+    int y0 = (int)center[1] - reach, y1 = (int)center[1] + reach;
+    if (x0 < 1) x0 = 1;
+    if (y0 < 1) y0 = 1;
+    if (x1 > fluid->size) x1 = fluid->size;
+    if (y1 > fluid->size) y1 = fluid->size;
+
+    for (int y = y0; y <= y1; y++) {
+        for (int x = x0; x <= x1; x++) {
+            float dx = x - center[0];
+            float dy = y - center[1];
+            float weight = expf(-(dx * dx + dy * dy) / (radius * radius));
+            int cell = IX(fluid, x, y);
+            fluid->u[cell] += (velocity[0] - fluid->u[cell]) * weight;
+            fluid->v[cell] += (velocity[1] - fluid->v[cell]) * weight;
+        }
+    }
+}
+
+typedef struct {
+    FluidField* fluid;
+    float dt0;
+    float decay;
+    float scale;
+    const float* source;
+    float* target;
+} FluidPass;
+
+static void advect_rows(void* data, int begin, int end) {
+    FluidPass* pass = (FluidPass*)data;
+    FluidField* fluid = pass->fluid;
+    for (int row = begin; row < end; row++) {
+        simd_get()->fluid_advect_row(fluid->u, fluid->v, fluid->u0, fluid->v0,
+                                     row, fluid->size, pass->dt0, pass->decay);
+    }
+}
+
+static void divergence_rows(void* data, int begin, int end) {
+    FluidPass* pass = (FluidPass*)data;
+    FluidField* fluid = pass->fluid;
+    for (int row = begin; row < end; row++) {
+        simd_get()->fluid_divergence_row(fluid->divergence, fluid->u, fluid->v, row, fluid->size, pass->scale);
+    }
+}
+
+static void jacobi_rows(void* data, int begin, int end) {
+    FluidPass* pass = (FluidPass*)data;
+    FluidField* fluid = pass->fluid;
+    for (int row = begin; row < end; row++) {
+        simd_get()->fluid_jacobi_row(pass->target, pass->source, fluid->divergence, row, fluid->size);
+    }
+}
+
+static void gradient_rows(void* data, int begin, int end) {
+    FluidPass* pass = (FluidPass*)data;
+    FluidField* fluid = pass->fluid;
+    for (int row = begin; row < end; row++) {
+        simd_get()->fluid_gradient_row(fluid->u, fluid->v, fluid->pressure, row, fluid->size, pass->scale);
+    }
+}
+
+static void step_cpu(FluidField* fluid, float deltaTime, const float* splatCenter, const float* splatVelocity) {
+    int n = fluid->size;
+    int cells = fluid_cells(fluid);
+    float h = fluid->cellSize;
+    FluidPass pass;
+    memset(&pass, 0, sizeof(pass));
+    pass.fluid = fluid;
+
+    if (splatCenter) {
+        splat_cpu(fluid, splatCenter, splatVelocity);
+    }
+
+    // Advect u, v through themselves
+    memcpy(fluid->u0, fluid->u, cells * sizeof(float));
+    memcpy(fluid->v0, fluid->v, cells * sizeof(float));
+    pass.dt0 = deltaTime / h;
+    pass.decay = expf(-fluid->dissipation * deltaTime);
+    job_parallel_for(1, n + 1, FLUID_ROW_GRAIN, advect_rows, &pass);
+    set_boundary(fluid, 1, fluid->u);
+    set_boundary(fluid, 2, fluid->v);
+
+    // Projection. Pressure is warm started from the previous step.
+    pass.scale = -0.5f * h;
+    job_parallel_for(1, n + 1, FLUID_ROW_GRAIN, divergence_rows, &pass);
+    // As in Stam's project(), the edges follow their interior neighbours
+    // before the solve. The GPU solver clamps its reads the same way.
+    set_boundary(fluid, 0, fluid->divergence);
+    set_boundary(fluid, 0, fluid->pressure);
+
+    for (int iter = 0; iter < fluid->pressureIterations; iter++) {
+        pass.source = fluid->pressure;
+        pass.target = fluid->pressure0;
+        job_parallel_for(1, n + 1, FLUID_ROW_GRAIN, jacobi_rows, &pass);
+        set_boundary(fluid, 0, fluid->pressure0);
+
+        float* swap = fluid->pressure;
+        fluid->pressure = fluid->pressure0;
+        fluid->pressure0 = swap;
+    }
+
+    pass.scale = 0.5f / h;
+    job_parallel_for(1, n + 1, FLUID_ROW_GRAIN, gradient_rows, &pass);
+    set_boundary(fluid, 1, fluid->u);
+    set_boundary(fluid, 2, fluid->v);
+
+    for (int i = 0; i < cells; i++) {
+        fluid->upload[2 * i] = fluid->u[i];
+        fluid->upload[2 * i + 1] = fluid->v[i];
+    }
+    glBindTexture(GL_TEXTURE_2D, fluid->velocityTextures[fluid->current]);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, n + 2, n + 2, GL_RG, GL_FLOAT, fluid->upload);
+}
+
+// GPU solver
+
+static unsigned int stage_program(FluidField* fluid, int stage) {
+    if (!fluid->stagePrograms[stage]) {
+        char value[8];
+        snprintf(value, sizeof(value), "%d", stage);
+        ShaderDefine define = { "FLUID_STAGE", value };
+        fluid->stagePrograms[stage] = shader_variant_cache_get(&fluid->stages, &define, 1);
+    }
+    return fluid->stagePrograms[stage];
+}
+
+static unsigned int use_stage(FluidField* fluid, int stage) {
+    unsigned int program = stage_program(fluid, stage);
+    glUseProgram(program);
+    glUniform1i(glGetUniformLocation(program, "size"), fluid->size);
+    return program;
+}
+
+static void dispatch_grid(const FluidField* fluid) {
+    int groups = (fluid->size + 2 + FLUID_LOCAL_SIZE - 1) / FLUID_LOCAL_SIZE;
+    glDispatchCompute(groups, groups, 1);
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+}
+
+static void step_gpu(FluidField* fluid, float deltaTime, const float* splatCenter, const float* splatVelocity) {
+    unsigned int* velocity = fluid->velocityTextures;
+    unsigned int program;
+
+    if (splatCenter) {
+        program = use_stage(fluid, FLUID_STAGE_SPLAT);
+        glUniform2fv(glGetUniformLocation(program, "splat_center"), 1, splatCenter);
+        glUniform2fv(glGetUniformLocation(program, "splat_velocity"), 1, splatVelocity);
+        glUniform1f(glGetUniformLocation(program, "splat_radius"), fluid->splatRadius / fluid->cellSize);
+        glBindImageTexture(0, velocity[fluid->current], 0, GL_FALSE, 0, GL_READ_WRITE, GL_RG32F);
+        dispatch_grid(fluid);
+    }
+
+    program = use_stage(fluid, FLUID_STAGE_ADVECT);
+    glUniform1f(glGetUniformLocation(program, "dt0"), deltaTime / fluid->cellSize);
+    glUniform1f(glGetUniformLocation(program, "decay"), expf(-fluid->dissipation * deltaTime));
+    glUniform1i(glGetUniformLocation(program, "source_velocity"), 0);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, velocity[fluid->current]);
+    glBindImageTexture(0, velocity[1 - fluid->current], 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RG32F);
+    dispatch_grid(fluid);
+    fluid->current = 1 - fluid->current;
+
+    use_stage(fluid, FLUID_STAGE_BOUNDARY);
+    glBindImageTexture(0, velocity[fluid->current], 0, GL_FALSE, 0, GL_READ_WRITE, GL_RG32F);
+    dispatch_grid(fluid);
+
+    program = use_stage(fluid, FLUID_STAGE_DIVERGENCE);
+    glUniform1f(glGetUniformLocation(program, "scale"), -0.5f * fluid->cellSize);
+    glBindImageTexture(0, velocity[fluid->current], 0, GL_FALSE, 0, GL_READ_ONLY, GL_RG32F);
+    glBindImageTexture(1, fluid->divergenceTexture, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+    dispatch_grid(fluid);
+
+    // Ping-pong the pressure, an even count leaves the result in pressureTextures[0]
+    use_stage(fluid, FLUID_STAGE_JACOBI);
+    glBindImageTexture(1, fluid->divergenceTexture, 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+    int iterations = (fluid->pressureIterations + 1) & ~1;
+    for (int iter = 0; iter < iterations; iter++) {
+        glBindImageTexture(0, fluid->pressureTextures[iter & 1], 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+        glBindImageTexture(2, fluid->pressureTextures[1 - (iter & 1)], 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+        dispatch_grid(fluid);
+    }
+
+    program = use_stage(fluid, FLUID_STAGE_GRADIENT);
+    glUniform1f(glGetUniformLocation(program, "scale"), 0.5f / fluid->cellSize);
+    glBindImageTexture(0, velocity[fluid->current], 0, GL_FALSE, 0, GL_READ_WRITE, GL_RG32F);
+    glBindImageTexture(1, fluid->pressureTextures[0], 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+    dispatch_grid(fluid);
+
+    use_stage(fluid, FLUID_STAGE_BOUNDARY);
+    glBindImageTexture(0, velocity[fluid->current], 0, GL_FALSE, 0, GL_READ_WRITE, GL_RG32F);
+    dispatch_grid(fluid);
+}
+
+void fluid_step(FluidField* fluid, float deltaTime) {
+    if (!fluid->enabled || !fluid->u || deltaTime <= 0.0f) {
+        fluid->wasDragging = false;
+        return;
+    }
+
+    // Drag velocity from the cursor motion since the last step
+    float center[2], dragVelocity[2];
+    const float* splatCenter = NULL;
+    if (fluid->dragging && fluid->wasDragging) {
+        dragVelocity[0] = (fluid->mousePos[0] - fluid->lastMousePos[0]) / deltaTime;
+        dragVelocity[1] = (fluid->mousePos[1] - fluid->lastMousePos[1]) / deltaTime;
+        world_to_cell(fluid, fluid->mousePos, center);
+        splatCenter = center;
+    }
+    fluid->lastMousePos[0] = fluid->mousePos[0];
+    fluid->lastMousePos[1] = fluid->mousePos[1];
+    fluid->wasDragging = fluid->dragging;
+
+    // Each solver keeps its own state, start from rest when switching
+    if (fluid->solver != fluid->activeSolver) {
+        fluid_reset(fluid);
+        fluid->activeSolver = fluid->solver;
+    }
+
+    double start = platform_time_seconds();
+    if (fluid->solver == FLUID_SOLVER_GPU) {
+        step_gpu(fluid, deltaTime, splatCenter, dragVelocity);
+    } else {
+        step_cpu(fluid, deltaTime, splatCenter, dragVelocity);
+    }
+    fluid->solveTimeMs = (float)((platform_time_seconds() - start) * 1000.0);
+}
+
+unsigned int fluid_velocity_texture(const FluidField* fluid) {
+    return fluid->velocityTextures[fluid->current];
+}
+
+void fluid_uv_transform(const FluidField* fluid, float* scale, float* offset) {
+    // Texel k is centered at (k + 0.5) / (size + 2), cell k at world -extent + (k - 0.5) * h
+    float texels = (float)(fluid->size + 2);
+    *scale = 1.0f / (fluid->cellSize * texels);
+    *offset = (fluid->extent / fluid->cellSize + 1.0f) / texels;
+}
+
+const char* fluid_solver_name(int solver) {
+    return solver == FLUID_SOLVER_GPU ? "GPU" : "CPU";
+}
+
+void fluid_cleanup(FluidField* fluid) {
+    free(fluid->u);
+    free(fluid->v);
+    free(fluid->u0);
+    free(fluid->v0);
+    free(fluid->pressure);
+    free(fluid->pressure0);
+    free(fluid->divergence);
+    free(fluid->upload);
+    fluid->u = fluid->v = fluid->u0 = fluid->v0 = NULL;
+    fluid->pressure = fluid->pressure0 = fluid->divergence = fluid->upload = NULL;
+
+    glDeleteTextures(2, fluid->velocityTextures);
+    glDeleteTextures(2, fluid->pressureTextures);
+    glDeleteTextures(1, &fluid->divergenceTexture);
+    shader_variant_cache_cleanup(&fluid->stages);
+}
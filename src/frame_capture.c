@@ -0,0 +1,263 @@
+#include "frame_capture.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Buffered writes, one frame is a few MB
+#define CAPTURE_WRITE_BUFFER (1 << 20)
+
+static size_t frame_bytes(const FrameCapture* capture) {
+    return (size_t)capture->width * capture->height * 4;
+}
+
+const char* frame_capture_format_name(int format) {
+    return format == CAPTURE_FORMAT_RAW ? "rgba" : "ppm";
+}
+
+static void write_frame(FrameCapture* capture, const CaptureFrame* frame, unsigned char* row) {
+    char path[600];
+    snprintf(path, sizeof(path), "%s/frame_%06llu.%s", capture->directory,
+             (unsigned long long)frame->frame, frame_capture_format_name(capture->format));
+    FILE* file = fopen(path, "wb");
+    if (!file) {
+        fprintf(stderr, "Failed to open %s for writing\n", path);
+        return;
+    }
+    setvbuf(file, NULL, _IOFBF, CAPTURE_WRITE_BUFFER);
+
+    if (capture->format == CAPTURE_FORMAT_RAW) {
+        fwrite(frame->pixels, 1, frame_bytes(capture), file);
+    } else {
+        // PPM wants RGB with the top row first, GL hands back RGBA bottom up
+        fprintf(file, "P6\n%d %d\n255\n", capture->width, capture->height);
+        for (int y = capture->height - 1; y >= 0; y--) {
+            const unsigned char* src = frame->pixels + (size_t)y * capture->width * 4;
+            for (int x = 0; x < capture->width; x++) {
+                row[x * 3 + 0] = src[x * 4 + 0];
+                row[x * 3 + 1] = src[x * 4 + 1];
+                row[x * 3 + 2] = src[x * 4 + 2];
+            }
+            fwrite(row, 1, (size_t)capture->width * 3, file);
+        }
+    }
+    fclose(file);
+}
+
+static void writer_main(void* arg) {
+    FrameCapture* capture = (FrameCapture*)arg;
+    unsigned char* row = (unsigned char*)malloc((size_t)capture->width * 3);
+
+    platform_mutex_lock(&capture->mutex);
+    for (;;) {
+        while (capture->queueCount == 0 && !capture->stopping) {
+            platform_cond_wait(&capture->ready, &capture->mutex);
+        }
+        if (capture->queueCount == 0) {
+            break;
+        }
+
+        // The head slot stays queued while it's written, so it isn't reused
+        CaptureFrame* frame = &capture->queue[capture->queueHead];
+        platform_mutex_unlock(&capture->mutex);
+        write_frame(capture, frame, row);
+        platform_mutex_lock(&capture->mutex);
+
+        capture->queueHead = (capture->queueHead + 1) % CAPTURE_QUEUE_FRAMES;
+        capture->queueCount--;
+        capture->written++;
+        platform_cond_signal(&capture->space);
+    }
+    platform_mutex_unlock(&capture->mutex);
+    free(row);
+}
+
+bool frame_capture_init(FrameCapture* capture, const char* directory, int width, int height, int format) {
+    memset(capture, 0, sizeof(*capture));
+    capture->width = width;
+    capture->height = height;
+    capture->format = format;
+    snprintf(capture->directory, sizeof(capture->directory), "%s", directory);
+
+    if (!platform_make_directory(capture->directory)) {
+        fprintf(stderr, "Failed to create capture directory %s\n", capture->directory);
+        return false;
+    }
+
+    glGenFramebuffers(1, &capture->framebuffer);
+    glGenRenderbuffers(1, &capture->colorBuffer);
+    glGenRenderbuffers(1, &capture->depthBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, capture->colorBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, capture->depthBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+    glBindFramebuffer(GL_FRAMEBUFFER, capture->framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, capture->colorBuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, capture->depthBuffer);
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        fprintf(stderr, "Capture framebuffer incomplete: 0x%x\n", status);
+        frame_capture_cleanup(capture);
+        return false;
+    }
+
+    glGenBuffers(CAPTURE_PBO_COUNT, capture->pbos);
+    for (int i = 0; i < CAPTURE_PBO_COUNT; i++) {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, capture->pbos[i]);
+        glBufferData(GL_PIXEL_PACK_BUFFER, frame_bytes(capture), NULL, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    if (!arena_init(&capture->arena, CAPTURE_QUEUE_FRAMES * (frame_bytes(capture) + ARENA_ALIGNMENT),
+                    ARENA_HUGE_PAGES | ARENA_PREFAULT)) {
+        frame_capture_cleanup(capture);
+        return false;
+    }
+    for (int i = 0; i < CAPTURE_QUEUE_FRAMES; i++) {
+        capture->queue[i].pixels = (unsigned char*)arena_alloc(&capture->arena, frame_bytes(capture));
+    }
+
+    platform_mutex_init(&capture->mutex);
+    platform_cond_init(&capture->ready);
+    platform_cond_init(&capture->space);
+    if (!platform_thread_create(&capture->writer, writer_main, capture)) {
+        fprintf(stderr, "Failed to start capture writer thread\n");
+        platform_cond_destroy(&capture->space);
+        platform_cond_destroy(&capture->ready);
+        platform_mutex_destroy(&capture->mutex);
+        frame_capture_cleanup(capture);
+        return false;
+    }
+
+    capture->startTime = platform_time_seconds();
+    printf("Capturing %dx%d %s frames to %s\n", width, height,
+           frame_capture_format_name(format), capture->directory);
+    return true;
+}
+
+void frame_capture_begin(FrameCapture* capture) {
+    glBindFramebuffer(GL_FRAMEBUFFER, capture->framebuffer);
+    glViewport(0, 0, capture->width, capture->height);
+}
+
+// Move a finished readback into the writer queue. With wait the caller blocks
+// for a free slot instead of dropping the frame.
+static void collect(FrameCapture* capture, int slot, bool wait) {
+    platform_mutex_lock(&capture->mutex);
+    while (wait && capture->queueCount == CAPTURE_QUEUE_FRAMES) {
+        platform_cond_wait(&capture->space, &capture->mutex);
+    }
+    bool full = capture->queueCount == CAPTURE_QUEUE_FRAMES;
+    int tail = (capture->queueHead + capture->queueCount) % CAPTURE_QUEUE_FRAMES;
+    platform_mutex_unlock(&capture->mutex);
+
+    if (full) {
+        capture->droppedWriter++;
+        return;
+    }
+
+    // Only this thread adds to the queue, so the tail slot stays free
+    CaptureFrame* frame = &capture->queue[tail];
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, capture->pbos[slot]);
+    const void* pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, frame_bytes(capture), GL_MAP_READ_BIT);
+    if (pixels) {
+        memcpy(frame->pixels, pixels, frame_bytes(capture));
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    if (!pixels) {
+        capture->droppedReadback++;
+        return;
+    }
+    frame->frame = capture->pboFrames[slot];
+
+    platform_mutex_lock(&capture->mutex);
+    capture->queueCount++;
+    platform_cond_signal(&capture->ready);
+    platform_mutex_unlock(&capture->mutex);
+}
+
+void frame_capture_end(FrameCapture* capture) {
+    int slot = capture->issued % CAPTURE_PBO_COUNT;
+    GLsync fence = capture->fences[slot];
+    if (fence) {
+        GLenum status = glClientWaitSync(fence, 0, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+            // Still copying a frame from CAPTURE_PBO_COUNT frames ago
+            capture->droppedReadback++;
+            capture->frame++;
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            return;
+        }
+        collect(capture, slot, false);
+        glDeleteSync(fence);
+        capture->fences[slot] = NULL;
+    }
+
+    // Asynchronous into the pixel buffer, returns without waiting for the GPU
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, capture->framebuffer);
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, capture->pbos[slot]);
+    glReadPixels(0, 0, capture->width, capture->height, GL_RGBA, GL_UNSIGNED_BYTE, (void*)0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    capture->fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    // No swap submits the frame and the polls above pass no flush bit, so
+    // without this the fence may never reach the GPU
+    glFlush();
+    capture->pboFrames[slot] = capture->frame;
+    capture->issued++;
+    capture->frame++;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void frame_capture_finish(FrameCapture* capture) {
+    if (!capture->framebuffer) {
+        return;
+    }
+
+    // Oldest first so files come out in order
+    for (int i = 0; i < CAPTURE_PBO_COUNT; i++) {
+        int slot = (capture->issued + i) % CAPTURE_PBO_COUNT;
+        GLsync fence = capture->fences[slot];
+        if (!fence) {
+            continue;
+        }
+        glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+        collect(capture, slot, true);
+        glDeleteSync(fence);
+        capture->fences[slot] = NULL;
+    }
+
+    platform_mutex_lock(&capture->mutex);
+    capture->stopping = true;
+    platform_cond_broadcast(&capture->ready);
+    platform_mutex_unlock(&capture->mutex);
+    platform_thread_join(&capture->writer);
+    platform_cond_destroy(&capture->space);
+    platform_cond_destroy(&capture->ready);
+    platform_mutex_destroy(&capture->mutex);
+
+    double elapsed = platform_time_seconds() - capture->startTime;
+    printf("Captured %llu of %llu frames in %.1f s (%.1f fps rendered, %.1f written), "
+           "dropped %llu on readback, %llu on disk\n",
+           (unsigned long long)capture->written, (unsigned long long)capture->frame, elapsed,
+           elapsed > 0.0 ? capture->frame / elapsed : 0.0, elapsed > 0.0 ? capture->written / elapsed : 0.0,
+           (unsigned long long)capture->droppedReadback, (unsigned long long)capture->droppedWriter);
+}
+
+void frame_capture_cleanup(FrameCapture* capture) {
+    for (int i = 0; i < CAPTURE_PBO_COUNT; i++) {
+        if (capture->fences[i]) {
+            glDeleteSync(capture->fences[i]);
+            capture->fences[i] = NULL;
+        }
+    }
+    glDeleteBuffers(CAPTURE_PBO_COUNT, capture->pbos);
+    glDeleteFramebuffers(1, &capture->framebuffer);
+    glDeleteRenderbuffers(1, &capture->colorBuffer);
+    glDeleteRenderbuffers(1, &capture->depthBuffer);
+    arena_release(&capture->arena);
+    capture->framebuffer = 0;
+}
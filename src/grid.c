@@ -46,18 +46,30 @@ static void create_grid_vertices(float* vertices, int* vertexCount, float size,
     *vertexCount = index / 3;
 }
 
-void grid_init(Grid* grid, float size, float spacing) {
+void grid_generate_vertices(Grid* grid, float size, float spacing) {
     grid->size = size;
     grid->spacing = spacing;
-    
+
     // Calculate grid vertices
     int linesPerAxis = (2 * size) / spacing + 1;
     int totalLines = linesPerAxis * 2;
     int maxVertices = totalLines * 2 * 3;
-    
-    float* gridVertices = (float*)malloc(maxVertices * sizeof(float));
-    int vertexCount;
-    create_grid_vertices(gridVertices, &vertexCount, size, spacing);
+
+    grid->vertices = (float*)malloc(maxVertices * sizeof(float));
+    grid->vertexCount = 0;
+    if (grid->vertices) {
+        create_grid_vertices(grid->vertices, &grid->vertexCount, size, spacing);
+    }
+}
+
+void grid_init(Grid* grid, float size, float spacing) {
+    // Vertices may already have been generated on a job thread
+    if (!grid->vertices || grid->size != size || grid->spacing != spacing) {
+        free(grid->vertices);
+        grid_generate_vertices(grid, size, spacing);
+    }
+    float* gridVertices = grid->vertices;
+    int vertexCount = grid->vertexCount;
     
     // Create and bind grid VAO and VBO
     glGenVertexArrays(1, &grid->VAO);
@@ -71,6 +83,7 @@ void grid_init(Grid* grid, float size, float spacing) {
     glEnableVertexAttribArray(0);
     
     free(gridVertices);
+    grid->vertices = NULL;
     
     // Compile grid shaders
     unsigned int vertexShader = glCreateShader(GL_VERTEX_SHADER);
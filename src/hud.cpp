@@ -1,6 +1,7 @@
 #include "hud.h"
 #include "imgui.h"
 #include <stdio.h>
+#include <string.h>
 
 extern "C" {
 
@@ -9,6 +10,24 @@ void hud_init(HUD* hud) {
     hud->stats.particleCount = 0;
     hud->stats.frameTime = 0.0f;
     hud->stats.deltaTime = 0.0f;
+    hud->stats.budgetEnabled = false;
+    hud->stats.budgetDecision = "Hold";
+    hud->stats.stepTime = 0.0f;
+    hud->stats.drawTime = 0.0f;
+    hud->stats.fusedUpdate = false;
+    hud->stats.budgetTarget = 0.0f;
+    hud->stats.particleCapacity = 0;
+    hud->stats.loadProgress = 1.0f;
+    hud->stats.sparseEnabled = false;
+    hud->stats.activeTiles = 0;
+    hud->stats.totalTiles = 0;
+    hud->stats.fluidEnabled = false;
+    hud->stats.fluidSolver = "CPU";
+    hud->stats.fluidTime = 0.0f;
+    hud->stats.brushEnabled = false;
+    hud->stats.brushOp = "None";
+    memset(&hud->stats.particleStats, 0, sizeof(hud->stats.particleStats));
+    hud->stats.workerCount = 0;
 }
 
 void hud_render(HUD* hud) {
@@ -27,7 +46,61 @@ void hud_render(HUD* hud) {
         ImGui::Text("FPS: %.1f", hud->stats.fps);
         ImGui::Text("Frame Time: %.2f ms", hud->stats.frameTime);
         ImGui::Text("Delta Time: %.3f ms", hud->stats.deltaTime * 1000.0f);
-        ImGui::Text("Particle Count: %d", hud->stats.particleCount);
+        ImGui::Text("Particle Count: %d / %d", hud->stats.particleCount, hud->stats.particleCapacity);
+        if (hud->stats.loadProgress < 1.0f) {
+            ImGui::ProgressBar(hud->stats.loadProgress, ImVec2(220, 0), "Loading particles");
+        }
+        if (hud->stats.fusedUpdate) {
+            ImGui::Text("Step + Draw: %.2f ms (fused)", hud->stats.drawTime);
+        } else {
+            ImGui::Text("Step: %.2f ms  Draw: %.2f ms", hud->stats.stepTime, hud->stats.drawTime);
+        }
+        if (hud->stats.budgetEnabled) {
+            ImGui::Text("Budget: %.1f ms (%s)", hud->stats.budgetTarget, hud->stats.budgetDecision);
+        } else {
+            ImGui::Text("Budget: off");
+        }
+        if (hud->stats.sparseEnabled) {
+            ImGui::Text("Active Tiles: %d / %d", hud->stats.activeTiles, hud->stats.totalTiles);
+        }
+        if (hud->stats.fluidEnabled) {
+            ImGui::Text("Fluid: %s %.2f ms", hud->stats.fluidSolver, hud->stats.fluidTime);
+        }
+        if (hud->stats.exportEnabled) {
+            ImGui::Text("Export: %llu frames, %llu dropped, %.2f ms",
+                        hud->stats.exportPublished, hud->stats.exportDropped, hud->stats.exportTime);
+        }
+        if (hud->stats.brushEnabled) {
+            ImGui::Text("Brush: %s, %d particles in %d cells", hud->stats.brushOp,
+                        hud->stats.brushMatches, hud->stats.brushCells);
+            ImGui::Text("Index: %.2f ms  Query: %.3f ms", hud->stats.brushBuildTime, hud->stats.brushQueryTime);
+        }
+
+        const ParticleStats* ps = &hud->stats.particleStats;
+        if (ps->valid) {
+            ImGui::Separator();
+            ImGui::Text("Kinetic Energy: %.3e", ps->kineticEnergy);
+            ImGui::Text("Center of Mass: (%.2f, %.2f)", ps->centerOfMass[0], ps->centerOfMass[1]);
+            ImGui::Text("Bounds: (%.1f, %.1f) - (%.1f, %.1f)",
+                        ps->boundsMin[0], ps->boundsMin[1], ps->boundsMax[0], ps->boundsMax[1]);
+            ImGui::Text("Max Speed: %.2f", ps->maxSpeed);
+
+            float bins[STATS_HISTOGRAM_BINS];
+            for (int i = 0; i < STATS_HISTOGRAM_BINS; i++) {
+                bins[i] = (float)ps->histogram[i];
+            }
+            ImGui::PlotHistogram("##speed", bins, STATS_HISTOGRAM_BINS, 0, "Speed", 0.0f, 3.402823466e+38f, ImVec2(220, 60));
+        }
+
+        if (hud->stats.workerCount > 0) {
+            ImGui::Separator();
+            ImGui::Text("Workers: %d", hud->stats.workerCount);
+            for (int i = 0; i < hud->stats.workerCount; i++) {
+                char label[32];
+                snprintf(label, sizeof(label), "%d: %.0f%%", i, hud->stats.workerUtilization[i] * 100.0f);
+                ImGui::ProgressBar(hud->stats.workerUtilization[i], ImVec2(220, 0), label);
+            }
+        }
     }
     ImGui::End();
 }
@@ -39,6 +112,61 @@ void hud_update_stats(HUD* hud, float fps, int particleCount, float frameTime, f
     hud->stats.deltaTime = deltaTime;
 }
 
+void hud_update_budget(HUD* hud, bool enabled, const char* decision, float stepTime,
+                       float drawTime, bool fusedUpdate, float targetTime, int particleCapacity) {
+    hud->stats.budgetEnabled = enabled;
+    hud->stats.budgetDecision = decision;
+    hud->stats.stepTime = stepTime;
+    hud->stats.drawTime = drawTime;
+    hud->stats.fusedUpdate = fusedUpdate;
+    hud->stats.budgetTarget = targetTime;
+    hud->stats.particleCapacity = particleCapacity;
+}
+
+void hud_update_particle_stats(HUD* hud, const ParticleStats* stats) {
+    hud->stats.particleStats = *stats;
+}
+
+void hud_update_activity(HUD* hud, bool enabled, int activeTiles, int totalTiles) {
+    hud->stats.sparseEnabled = enabled;
+    hud->stats.activeTiles = activeTiles;
+    hud->stats.totalTiles = totalTiles;
+}
+
+void hud_update_fluid(HUD* hud, bool enabled, const char* solver, float solveTime) {
+    hud->stats.fluidEnabled = enabled;
+    hud->stats.fluidSolver = solver;
+    hud->stats.fluidTime = solveTime;
+}
+
+void hud_update_export(HUD* hud, bool enabled, unsigned long long published,
+                       unsigned long long dropped, float publishTime) {
+    hud->stats.exportEnabled = enabled;
+    hud->stats.exportPublished = published;
+    hud->stats.exportDropped = dropped;
+    hud->stats.exportTime = publishTime;
+}
+
+void hud_update_brush(HUD* hud, bool enabled, const char* op, int matches, int cells,
+                      float buildTime, float queryTime) {
+    hud->stats.brushEnabled = enabled;
+    hud->stats.brushOp = op;
+    hud->stats.brushMatches = matches;
+    hud->stats.brushCells = cells;
+    hud->stats.brushBuildTime = buildTime;
+    hud->stats.brushQueryTime = queryTime;
+}
+
+void hud_update_loading(HUD* hud, float progress) {
+    hud->stats.loadProgress = progress;
+}
+
+void hud_update_jobs(HUD* hud, const float* utilization, int workerCount) {
+    if (workerCount > HUD_MAX_WORKERS) workerCount = HUD_MAX_WORKERS;
+    memcpy(hud->stats.workerUtilization, utilization, workerCount * sizeof(float));
+    hud->stats.workerCount = workerCount;
+}
+
 void hud_cleanup(HUD* hud) {
     // Nothing to cleanup for now
 }
@@ -0,0 +1,432 @@
+#include "job_system.h"
+#include "platform.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define JOB_DEQUE_CAPACITY 4096
+#define JOB_IDLE_WAIT_MS 2
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#define JOB_THREAD_LOCAL __declspec(thread)
+#else
+#define JOB_THREAD_LOCAL _Thread_local
+#endif
+
+struct Job {
+    JobFunc func;
+    void* data;
+    JobCounter* counter;
+    Job* next;
+};
+
+// Owner pushes and pops at the bottom, thieves take from the top
+typedef struct {
+    atomic_flag lock;
+    Job* jobs[JOB_DEQUE_CAPACITY];
+    int top;
+    int bottom;
+} JobDeque;
+
+typedef struct {
+    JobDeque deque;
+    PlatformThread thread;
+    atomic_llong busyNs;
+    uint32_t stealSeed;
+} JobWorker;
+
+typedef struct {
+    JobWorker workers[JOB_MAX_WORKERS];
+    int workerCount;
+    atomic_bool running;
+    atomic_int queued;
+    atomic_uint nextExternal;
+    PlatformMutex sleepLock;
+    PlatformCond wake;
+    double lastSample;
+} JobSystem;
+
+static JobSystem jobs;
+static JOB_THREAD_LOCAL int workerIndex = -1;
+
+static void spin_lock(atomic_flag* lock) {
+    while (atomic_flag_test_and_set_explicit(lock, memory_order_acquire)) {
+        // spin
+    }
+}
+
+static void spin_unlock(atomic_flag* lock) {
+    atomic_flag_clear_explicit(lock, memory_order_release);
+}
+
+static bool deque_push(JobDeque* deque, Job* job) {
+    spin_lock(&deque->lock);
+    bool pushed = deque->bottom - deque->top < JOB_DEQUE_CAPACITY;
+    if (pushed) {
+        deque->jobs[deque->bottom % JOB_DEQUE_CAPACITY] = job;
+        deque->bottom++;
+    }
+    spin_unlock(&deque->lock);
+    return pushed;
+}
+
+static Job* deque_pop(JobDeque* deque) {
+    Job* job = NULL;
+    spin_lock(&deque->lock);
+    if (deque->bottom > deque->top) {
+        deque->bottom--;
+        job = deque->jobs[deque->bottom % JOB_DEQUE_CAPACITY];
+    }
+    spin_unlock(&deque->lock);
+    return job;
+}
+
+static Job* deque_steal(JobDeque* deque) {
+    Job* job = NULL;
+    spin_lock(&deque->lock);
+    if (deque->bottom > deque->top) {
+        job = deque->jobs[deque->top % JOB_DEQUE_CAPACITY];
+        deque->top++;
+    }
+    spin_unlock(&deque->lock);
+    return job;
+}
+
+static void execute(Job* job);
+
+static void enqueue(Job* job) {
+    // External threads spread their jobs round-robin
+    int index = workerIndex;
+    if (index < 0) {
+        index = (int)(atomic_fetch_add(&jobs.nextExternal, 1) % jobs.workerCount);
+    }
+
+    if (!deque_push(&jobs.workers[index].deque, job)) {
+        execute(job);
+        return;
+    }
+
+    atomic_fetch_add(&jobs.queued, 1);
+    platform_mutex_lock(&jobs.sleepLock);
+    platform_cond_signal(&jobs.wake);
+    platform_mutex_unlock(&jobs.sleepLock);
+}
+
+static void enqueue_all(Job* job) {
+    while (job) {
+        Job* next = job->next;
+        job->next = NULL;
+        enqueue(job);
+        job = next;
+    }
+}
+
+// The counter may live on a waiter's stack: the final decrement happens
+// under its lock together with detaching the continuations, and job_done
+// takes the same lock, so nothing touches *counter once a waiter returns
+static void counter_finish(JobCounter* counter) {
+    if (!counter) {
+        return;
+    }
+
+    spin_lock(&counter->lock);
+    Job* continuations = NULL;
+    bool finished = atomic_fetch_sub(&counter->pending, 1) == 1;
+    if (finished) {
+        continuations = counter->continuations;
+        counter->continuations = NULL;
+    }
+    spin_unlock(&counter->lock);
+
+    if (finished) {
+        enqueue_all(continuations);
+        // Waiters sleep on the same condition as idle workers
+        platform_mutex_lock(&jobs.sleepLock);
+        platform_cond_broadcast(&jobs.wake);
+        platform_mutex_unlock(&jobs.sleepLock);
+    }
+}
+
+static void execute(Job* job) {
+    int index = workerIndex;
+    double start = platform_time_seconds();
+
+    job->func(job->data);
+
+    if (index >= 0) {
+        long long ns = (long long)((platform_time_seconds() - start) * 1e9);
+        atomic_fetch_add_explicit(&jobs.workers[index].busyNs, ns, memory_order_relaxed);
+    }
+
+    JobCounter* counter = job->counter;
+    free(job);
+    counter_finish(counter);
+}
+
+static Job* find_job(int index) {
+    Job* job = NULL;
+    if (index >= 0) {
+        job = deque_pop(&jobs.workers[index].deque);
+        if (job) {
+            return job;
+        }
+    }
+
+    // Steal starting from a pseudo-random victim
+    uint32_t seed = index >= 0 ? jobs.workers[index].stealSeed : 0x9E3779B9u;
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    if (index >= 0) {
+        jobs.workers[index].stealSeed = seed;
+    }
+
+    for (int i = 0; i < jobs.workerCount; i++) {
+        int victim = (int)((seed + i) % jobs.workerCount);
+        if (victim == index) {
+            continue;
+        }
+        job = deque_steal(&jobs.workers[victim].deque);
+        if (job) {
+            return job;
+        }
+    }
+    return NULL;
+}
+
+static bool run_one(void) {
+    Job* job = find_job(workerIndex);
+    if (!job) {
+        return false;
+    }
+    atomic_fetch_sub(&jobs.queued, 1);
+    execute(job);
+    return true;
+}
+
+static void worker_main(void* arg) {
+    workerIndex = (int)(size_t)arg;
+
+    while (atomic_load(&jobs.running)) {
+        if (run_one()) {
+            continue;
+        }
+
+        platform_mutex_lock(&jobs.sleepLock);
+        if (atomic_load(&jobs.running) && atomic_load(&jobs.queued) <= 0) {
+            platform_cond_timed_wait(&jobs.wake, &jobs.sleepLock, JOB_IDLE_WAIT_MS);
+        }
+        platform_mutex_unlock(&jobs.sleepLock);
+    }
+}
+
+void job_system_init(int workerCount) {
+    if (workerCount <= 0) {
+        workerCount = platform_cpu_count();
+    }
+    if (workerCount > JOB_MAX_WORKERS) {
+        workerCount = JOB_MAX_WORKERS;
+    }
+
+    memset(&jobs, 0, sizeof(jobs));
+    jobs.workerCount = workerCount;
+    atomic_store(&jobs.running, true);
+    platform_mutex_init(&jobs.sleepLock);
+    platform_cond_init(&jobs.wake);
+    jobs.lastSample = platform_time_seconds();
+
+    for (int i = 0; i < workerCount; i++) {
+        atomic_flag_clear(&jobs.workers[i].deque.lock);
+        jobs.workers[i].stealSeed = 0x9E3779B9u * (uint32_t)(i + 1);
+    }
+
+    // Worker 0 is the calling (main) thread
+    workerIndex = 0;
+    for (int i = 1; i < workerCount; i++) {
+        if (!platform_thread_create(&jobs.workers[i].thread, worker_main, (void*)(size_t)i)) {
+            fprintf(stderr, "Failed to start job worker %d\n", i);
+            jobs.workerCount = i;
+            break;
+        }
+    }
+}
+
+void job_system_shutdown(void) {
+    atomic_store(&jobs.running, false);
+    platform_mutex_lock(&jobs.sleepLock);
+    platform_cond_broadcast(&jobs.wake);
+    platform_mutex_unlock(&jobs.sleepLock);
+
+    for (int i = 1; i < jobs.workerCount; i++) {
+        platform_thread_join(&jobs.workers[i].thread);
+    }
+
+    // Drain anything left so counters still complete
+    while (run_one()) {
+    }
+
+    platform_cond_destroy(&jobs.wake);
+    platform_mutex_destroy(&jobs.sleepLock);
+    jobs.workerCount = 0;
+}
+
+int job_system_worker_count(void) {
+    return jobs.workerCount;
+}
+
+static Job* create_job(JobCounter* counter, JobFunc func, void* data) {
+    Job* job = (Job*)malloc(sizeof(Job));
+    if (!job) {
+        return NULL;
+    }
+    job->func = func;
+    job->data = data;
+    job->counter = counter;
+    job->next = NULL;
+    if (counter) {
+        atomic_fetch_add(&counter->pending, 1);
+    }
+    return job;
+}
+
+void job_submit(JobCounter* counter, JobFunc func, void* data) {
+    // Without a scheduler everything runs inline
+    if (jobs.workerCount == 0) {
+        func(data);
+        return;
+    }
+
+    Job* job = create_job(counter, func, data);
+    if (!job) {
+        func(data);
+        return;
+    }
+    enqueue(job);
+}
+
+void job_submit_after(JobCounter* dependency, JobCounter* counter, JobFunc func, void* data) {
+    if (jobs.workerCount == 0) {
+        job_wait(dependency);
+        func(data);
+        return;
+    }
+
+    Job* job = create_job(counter, func, data);
+    if (!job) {
+        job_wait(dependency);
+        func(data);
+        return;
+    }
+
+    // Checked under the dependency's lock so a finishing job can't miss us
+    spin_lock(&dependency->lock);
+    if (atomic_load(&dependency->pending) > 0) {
+        job->next = dependency->continuations;
+        dependency->continuations = job;
+        job = NULL;
+    }
+    spin_unlock(&dependency->lock);
+
+    if (job) {
+        enqueue(job);
+    }
+}
+
+bool job_done(JobCounter* counter) {
+    if (atomic_load(&counter->pending) != 0) {
+        return false;
+    }
+    // Pending reached zero, wait for the finishing job to let go of the lock
+    spin_lock(&counter->lock);
+    bool done = atomic_load(&counter->pending) == 0;
+    spin_unlock(&counter->lock);
+    return done;
+}
+
+void job_wait(JobCounter* counter) {
+    while (!job_done(counter)) {
+        if (jobs.workerCount > 0 && run_one()) {
+            continue;
+        }
+
+        // Nothing to help with, sleep until some counter finishes or work arrives
+        platform_mutex_lock(&jobs.sleepLock);
+        if (!job_done(counter) && atomic_load(&jobs.queued) <= 0) {
+            platform_cond_timed_wait(&jobs.wake, &jobs.sleepLock, JOB_IDLE_WAIT_MS);
+        }
+        platform_mutex_unlock(&jobs.sleepLock);
+    }
+}
+
+typedef struct {
+    JobRangeFunc func;
+    void* data;
+    int begin;
+    int end;
+} RangeJob;
+
+static void range_job(void* arg) {
+    RangeJob* range = (RangeJob*)arg;
+    range->func(range->data, range->begin, range->end);
+}
+
+void job_parallel_for(int begin, int end, int grain, JobRangeFunc func, void* data) {
+    int count = end - begin;
+    if (count <= 0) {
+        return;
+    }
+    if (grain < 1) {
+        grain = 1;
+    }
+
+    // A few chunks per worker so stealing can even out imbalance
+    int workers = jobs.workerCount > 0 ? jobs.workerCount : 1;
+    int chunks = workers * 4;
+    if (chunks > count / grain) chunks = count / grain;
+    if (chunks < 1) chunks = 1;
+
+    if (chunks == 1) {
+        func(data, begin, end);
+        return;
+    }
+
+    RangeJob* ranges = (RangeJob*)malloc(chunks * sizeof(RangeJob));
+    if (!ranges) {
+        func(data, begin, end);
+        return;
+    }
+
+    JobCounter counter;
+    memset(&counter, 0, sizeof(counter));
+    int perChunk = count / chunks;
+    for (int i = 0; i < chunks; i++) {
+        ranges[i].func = func;
+        ranges[i].data = data;
+        ranges[i].begin = begin + i * perChunk;
+        ranges[i].end = (i == chunks - 1) ? end : begin + (i + 1) * perChunk;
+    }
+
+    // Keep the first chunk for ourselves
+    for (int i = 1; i < chunks; i++) {
+        job_submit(&counter, range_job, &ranges[i]);
+    }
+    range_job(&ranges[0]);
+    job_wait(&counter);
+
+    free(ranges);
+}
+
+int job_system_utilization(float* utilization, int maxWorkers) {
+    double now = platform_time_seconds();
+    double elapsed = now - jobs.lastSample;
+    jobs.lastSample = now;
+
+    int count = jobs.workerCount < maxWorkers ? jobs.workerCount : maxWorkers;
+    for (int i = 0; i < count; i++) {
+        long long busy = atomic_exchange_explicit(&jobs.workers[i].busyNs, 0, memory_order_relaxed);
+        float fraction = elapsed > 0.0 ? (float)(busy / (elapsed * 1e9)) : 0.0f;
+        utilization[i] = fraction > 1.0f ? 1.0f : fraction;
+    }
+    return count;
+}
@@ -0,0 +1,284 @@
+#include "kernel_tuner.h"
+#include <stdio.h>
+#include <string.h>
+
+static const int candidateLocalSizes[] = { 64, 128, 256, 512 };
+static const int candidatePerInvocation[] = { 1, 2 };
+
+// FNV-1a over the strings that identify the driver and GPU
+static unsigned long long device_hash(void) {
+    const GLenum names[] = { GL_VENDOR, GL_RENDERER, GL_VERSION };
+    unsigned long long h = 0xcbf29ce484222325ULL;
+    for (int i = 0; i < 3; i++) {
+        const char* text = (const char*)glGetString(names[i]);
+        for (const char* c = text ? text : ""; *c; c++) {
+            h ^= (unsigned char)*c;
+            h *= 0x100000001b3ULL;
+        }
+        h ^= '|';
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+// Last matching line wins, so retuning just appends
+static bool load_cached(unsigned long long device, int particleCount, KernelTuning* tuning) {
+    FILE* file = fopen(KERNEL_TUNER_CACHE_FILE, "r");
+    if (!file) {
+        return false;
+    }
+
+    bool found = false;
+    char line[512];
+    while (fgets(line, sizeof(line), file)) {
+        unsigned long long lineDevice;
+        int count, localSize, perInvocation;
+        float stepMs;
+        if (sscanf(line, "%llx %d %d %d %f", &lineDevice, &count, &localSize, &perInvocation, &stepMs) == 5 &&
+            lineDevice == device && count == particleCount) {
+            tuning->localSize = localSize;
+            tuning->particlesPerInvocation = perInvocation;
+            tuning->stepMs = stepMs;
+            found = true;
+        }
+    }
+    fclose(file);
+    return found;
+}
+
+static void store_cached(unsigned long long device, int particleCount, const KernelTuning* tuning) {
+    FILE* file = fopen(KERNEL_TUNER_CACHE_FILE, "a");
+    if (!file) {
+        fprintf(stderr, "Failed to write %s\n", KERNEL_TUNER_CACHE_FILE);
+        return;
+    }
+    const char* renderer = (const char*)glGetString(GL_RENDERER);
+    fprintf(file, "%016llx %d %d %d %.4f %s\n", device, particleCount, tuning->localSize,
+            tuning->particlesPerInvocation, tuning->stepMs, renderer ? renderer : "");
+    fclose(file);
+}
+
+static void apply(KernelTuner* tuner, ParticleSystem* ps) {
+    KernelTuning* tuning = &tuner->result;
+    ps->kernel.localSize = tuning->localSize;
+    ps->kernel.particlesPerInvocation = tuning->particlesPerInvocation;
+    ps->computeProgram = particle_system_kernel(ps);
+    if (tuning->localSize != ps->activeKernel.localSize ||
+        tuning->particlesPerInvocation != ps->activeKernel.particlesPerInvocation) {
+        // Choice no longer compiles, stay on the default kernel
+        tuning->localSize = ps->kernel.localSize;
+        tuning->particlesPerInvocation = ps->kernel.particlesPerInvocation;
+    }
+    ps->tilesStale = true;
+
+    printf("Particle kernel: local size %d, %d particle%s per invocation, %.3f ms%s\n",
+           tuning->localSize, tuning->particlesPerInvocation, tuning->particlesPerInvocation == 1 ? "" : "s",
+           tuning->stepMs, tuning->cached ? " (cached)" : "");
+}
+
+void kernel_tuner_init(KernelTuner* tuner, ParticleSystem* ps) {
+    memset(tuner, 0, sizeof(*tuner));
+    tuner->device = device_hash();
+    tuner->result.localSize = ps->kernel.localSize;
+    tuner->result.particlesPerInvocation = ps->kernel.particlesPerInvocation;
+    tuner->result.stepMs = -1.0f;
+
+    // Nothing that needs extra buffers or tile state. Stats stay off, their
+    // partials and histogram belong to the frame's real update.
+    tuner->base = ps->kernel;
+    tuner->base.collectStats = false;
+    tuner->base.sparse = false;
+    tuner->base.fluid = false;
+    tuner->base.flags = false;
+
+    GLint maxInvocations = 0, maxSizeX = 0;
+    glGetIntegerv(GL_MAX_COMPUTE_WORK_GROUP_INVOCATIONS, &maxInvocations);
+    glGetIntegeri_v(GL_MAX_COMPUTE_WORK_GROUP_SIZE, 0, &maxSizeX);
+    for (size_t l = 0; l < sizeof(candidateLocalSizes) / sizeof(candidateLocalSizes[0]); l++) {
+        for (size_t p = 0; p < sizeof(candidatePerInvocation) / sizeof(candidatePerInvocation[0]); p++) {
+            if (candidateLocalSizes[l] > maxInvocations || candidateLocalSizes[l] > maxSizeX ||
+                tuner->candidateCount == KERNEL_TUNER_MAX_CANDIDATES) {
+                continue;
+            }
+            KernelCandidate* candidate = &tuner->candidates[tuner->candidateCount++];
+            candidate->localSize = candidateLocalSizes[l];
+            candidate->particlesPerInvocation = candidatePerInvocation[p];
+        }
+    }
+
+    glGenBuffers(1, &tuner->tableBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, tuner->tableBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, MAX_PARTICLE_GROUPS * sizeof(ParticleGroupGPU), NULL, GL_DYNAMIC_DRAW);
+    glGenQueries(KERNEL_TUNER_SAMPLES, tuner->queries);
+    tuner->running = true;
+}
+
+// Streaming fills the pool over the first frames, the cache lookup and the
+// timing wait for the loaded particles so they measure what gets simulated
+static bool start(KernelTuner* tuner, ParticleSystem* ps) {
+    int loaded = 0;
+    for (int i = 0; i < ps->groupCount; i++) {
+        loaded += ps->groups[i].loaded;
+    }
+    if (loaded == 0 || particle_system_load_progress(ps) < 1.0f) {
+        return false;
+    }
+    tuner->started = true;
+    tuner->particleCount = loaded;
+
+    if (load_cached(tuner->device, loaded, &tuner->result)) {
+        tuner->result.cached = true;
+        tuner->running = false;
+        apply(tuner, ps);
+        return false;
+    }
+    printf("Tuning particle kernel for %d particles over the next frames\n", loaded);
+    return true;
+}
+
+// One entry per group over its loaded particles, tiled for the candidate.
+// Zero time step, force and damping leave positions and velocities as they
+// are, so timing runs over the live particles.
+static void upload_table(KernelTuner* tuner, ParticleSystem* ps, int tileSize) {
+    ParticleGroupGPU table[MAX_PARTICLE_GROUPS];
+    int workGroups = 0;
+    int tableCount = 0;
+    for (int i = 0; i < ps->groupCount; i++) {
+        const ParticleGroup* group = &ps->groups[i];
+        if (group->loaded <= 0) {
+            continue;
+        }
+        ParticleGroupGPU* entry = &table[tableCount++];
+        memset(entry, 0, sizeof(*entry));
+        entry->offset = group->offset;
+        entry->count = group->loaded;
+        entry->firstWorkGroup = workGroups;
+        entry->damping = 1.0f;
+        entry->invMass = 1.0f;
+        workGroups += (group->loaded + tileSize - 1) / tileSize;
+    }
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, tuner->tableBuffer);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, tableCount * sizeof(ParticleGroupGPU), table);
+    tuner->tableCount = tableCount;
+    tuner->workGroups = workGroups;
+}
+
+static void finish(KernelTuner* tuner, ParticleSystem* ps) {
+    tuner->running = false;
+    if (tuner->result.stepMs >= 0.0f) {
+        store_cached(tuner->device, tuner->particleCount, &tuner->result);
+    }
+    apply(tuner, ps);
+
+    // Keep only the winner compiled
+    for (int i = 0; i < tuner->candidateCount; i++) {
+        if (tuner->candidates[i].program != ps->computeProgram) {
+            shader_variant_cache_release(&ps->computeVariants, tuner->candidates[i].program);
+        }
+        tuner->candidates[i].program = 0;
+    }
+}
+
+// Fastest timed dispatch of the current candidate, false while some results
+// are still pending
+static bool collect_samples(KernelTuner* tuner, float* best) {
+    for (int i = 0; i < KERNEL_TUNER_SAMPLES; i++) {
+        GLint available = 0;
+        glGetQueryObjectiv(tuner->queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) {
+            return false;
+        }
+    }
+
+    *best = -1.0f;
+    for (int i = 0; i < KERNEL_TUNER_SAMPLES; i++) {
+        GLuint64 ns = 0;
+        glGetQueryObjectui64v(tuner->queries[i], GL_QUERY_RESULT, &ns);
+        float ms = ns / 1000000.0f;
+        if (*best < 0.0f || ms < *best) {
+            *best = ms;
+        }
+    }
+    return true;
+}
+
+void kernel_tuner_step(KernelTuner* tuner, ParticleSystem* ps) {
+    if (!tuner->running || (!tuner->started && !start(tuner, ps))) {
+        return;
+    }
+
+    KernelCandidate* candidate = &tuner->candidates[tuner->current];
+    if (tuner->dispatched == KERNEL_TUNER_WARMUP + KERNEL_TUNER_SAMPLES) {
+        float ms;
+        if (!collect_samples(tuner, &ms)) {
+            return;
+        }
+        printf("  local size %4d x %d per invocation: %7.3f ms\n",
+               candidate->localSize, candidate->particlesPerInvocation, ms);
+        if (tuner->result.stepMs < 0.0f || ms < tuner->result.stepMs) {
+            tuner->result.localSize = candidate->localSize;
+            tuner->result.particlesPerInvocation = candidate->particlesPerInvocation;
+            tuner->result.stepMs = ms;
+        }
+        tuner->current++;
+        tuner->dispatched = 0;
+    }
+
+    // Variants that fail to build are skipped
+    while (tuner->current < tuner->candidateCount && tuner->dispatched == 0) {
+        candidate = &tuner->candidates[tuner->current];
+        ParticleKernelConfig config = tuner->base;
+        config.localSize = candidate->localSize;
+        config.particlesPerInvocation = candidate->particlesPerInvocation;
+        candidate->program = particle_system_kernel_variant(ps, &config);
+        if (candidate->program) {
+            break;
+        }
+        tuner->current++;
+    }
+    if (tuner->current == tuner->candidateCount) {
+        finish(tuner, ps);
+        return;
+    }
+
+    const float farAway[2] = { 1.0e4f, 1.0e4f };
+    unsigned int program = candidate->program;
+    int tileSize = candidate->localSize * candidate->particlesPerInvocation;
+    if (tuner->dispatched == 0) {
+        upload_table(tuner, ps, tileSize);
+    }
+    glUseProgram(program);
+    glUniform1f(glGetUniformLocation(program, "delta_time"), 0.0f);
+    glUniform2fv(glGetUniformLocation(program, "mouse_pos"), 1, farAway);
+    glUniform1f(glGetUniformLocation(program, "force_radius"), 0.0f);
+    glUniform1ui(glGetUniformLocation(program, "group_count"), tuner->tableCount);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, ps->positionBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, ps->velocityBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, ps->velocityMagBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, tuner->tableBuffer);
+
+    // After this frame's update, before the draw reads the buffers
+    int sample = tuner->dispatched - KERNEL_TUNER_WARMUP;
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    if (sample >= 0) {
+        glBeginQuery(GL_TIME_ELAPSED, tuner->queries[sample]);
+    }
+    glDispatchCompute(tuner->workGroups, 1, 1);
+    if (sample >= 0) {
+        glEndQuery(GL_TIME_ELAPSED);
+    }
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, ps->groupTableBuffer);
+    tuner->dispatched++;
+}
+
+void kernel_tuner_cleanup(KernelTuner* tuner) {
+    if (tuner->tableBuffer) {
+        glDeleteBuffers(1, &tuner->tableBuffer);
+        glDeleteQueries(KERNEL_TUNER_SAMPLES, tuner->queries);
+        tuner->tableBuffer = 0;
+    }
+    tuner->running = false;
+}
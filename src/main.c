@@ -1,8 +1,20 @@
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include "camera.h"
 #include "world.h"
+#include "simd_kernels.h"
+#include "job_system.h"
+#include "frame_capture.h"
+#include "cpu_sim.h"
+
+#define SIMD_BENCH_DEFAULT_PARTICLES 16000000
+#define NUMA_BENCH_DEFAULT_PARTICLES 32000000
+#define CAPTURE_DEFAULT_FRAMES 600
+#define CAPTURE_DEFAULT_WIDTH 1920
+#define CAPTURE_DEFAULT_HEIGHT 1080
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height) {
     glViewport(0, 0, width, height);
@@ -93,10 +105,70 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
         case GLFW_KEY_SPACE:
             camera_reset(&camera);
             break;
+        case GLFW_KEY_P:
+            particle_system_set_palette(&world.particles,
+                                        (world.particles.colormap.palette + 1) % COLORMAP_COUNT);
+            break;
     }
 }
 
-int main() {
+int main(int argc, char** argv) {
+    // Command line: --isa=<sse2|avx2|avx512> forces CPU kernels,
+    // --bench-simd[=particles] prints per-ISA throughput and exits,
+    // --bench-numa[=particles] times the NUMA-partitioned CPU simulation,
+    // --bench-fused compares the fused and two-pass updates once loaded,
+    // --capture=<dir> renders offscreen without a visible window and writes
+    // frames to dir, with --capture-frames=N (0 runs until killed),
+    // --capture-size=WxH and --capture-format=<ppm|raw>
+    const char* forcedIsa = NULL;
+    int benchParticles = 0;
+    int numaParticles = 0;
+    bool benchFused = false;
+    const char* captureDir = NULL;
+    int captureFrames = CAPTURE_DEFAULT_FRAMES;
+    int captureWidth = CAPTURE_DEFAULT_WIDTH;
+    int captureHeight = CAPTURE_DEFAULT_HEIGHT;
+    int captureFormat = CAPTURE_FORMAT_PPM;
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--isa=", 6) == 0) {
+            forcedIsa = argv[i] + 6;
+        } else if (strncmp(argv[i], "--bench-simd", 12) == 0) {
+            benchParticles = argv[i][12] == '=' ? atoi(argv[i] + 13) : SIMD_BENCH_DEFAULT_PARTICLES;
+        } else if (strncmp(argv[i], "--bench-numa", 12) == 0) {
+            numaParticles = argv[i][12] == '=' ? atoi(argv[i] + 13) : NUMA_BENCH_DEFAULT_PARTICLES;
+        } else if (strcmp(argv[i], "--bench-fused") == 0) {
+            benchFused = true;
+        } else if (strncmp(argv[i], "--capture=", 10) == 0) {
+            captureDir = argv[i] + 10;
+        } else if (strncmp(argv[i], "--capture-frames=", 17) == 0) {
+            captureFrames = atoi(argv[i] + 17);
+        } else if (strncmp(argv[i], "--capture-size=", 15) == 0) {
+            if (sscanf(argv[i] + 15, "%dx%d", &captureWidth, &captureHeight) != 2 ||
+                captureWidth <= 0 || captureHeight <= 0) {
+                fprintf(stderr, "Invalid capture size %s, expected WxH\n", argv[i] + 15);
+                return -1;
+            }
+        } else if (strncmp(argv[i], "--capture-format=", 17) == 0) {
+            captureFormat = strcmp(argv[i] + 17, "raw") == 0 ? CAPTURE_FORMAT_RAW : CAPTURE_FORMAT_PPM;
+        }
+    }
+
+    simd_dispatch_init(forcedIsa);
+
+    // Main thread becomes worker 0
+    job_system_init(0);
+
+    if (benchParticles > 0 || numaParticles > 0) {
+        if (benchParticles > 0) {
+            simd_benchmark(benchParticles);
+        }
+        if (numaParticles > 0) {
+            cpu_sim_benchmark(numaParticles);
+        }
+        job_system_shutdown();
+        return 0;
+    }
+
     // Initialize GLFW
     if (!glfwInit()) {
         fprintf(stderr, "Failed to initialize GLFW\n");
@@ -109,11 +181,18 @@ int main() {
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
     glfwWindowHint(GLFW_DECORATED, GLFW_FALSE);
 
-    // Create window
-    GLFWmonitor* monitor = glfwGetPrimaryMonitor();
-    const GLFWvidmode* mode = glfwGetVideoMode(monitor);
-    windowWidth = mode->width;
-    windowHeight = mode->height;
+    // Create window. Capture renders offscreen, the hidden window only
+    // provides the context, so no monitor is needed.
+    if (captureDir) {
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        windowWidth = captureWidth;
+        windowHeight = captureHeight;
+    } else {
+        GLFWmonitor* monitor = glfwGetPrimaryMonitor();
+        const GLFWvidmode* mode = glfwGetVideoMode(monitor);
+        windowWidth = mode->width;
+        windowHeight = mode->height;
+    }
     
     GLFWwindow* window = glfwCreateWindow(windowWidth, windowHeight, "Particle Simulation", NULL, NULL);
     if (!window) {
@@ -145,10 +224,26 @@ int main() {
     // Initialize camera and world
     camera_init(&camera, windowWidth, windowHeight);
     world_init(&world, window);
+    if (benchFused) {
+        world_request_render_benchmark(&world);
+    }
 
     // Add key callback
     glfwSetKeyCallback(window, key_callback);
 
+    FrameCapture capture;
+    bool capturing = false;
+    if (captureDir) {
+        capturing = frame_capture_init(&capture, captureDir, captureWidth, captureHeight, captureFormat);
+        if (!capturing) {
+            world_cleanup(&world);
+            glfwDestroyWindow(window);
+            glfwTerminate();
+            job_system_shutdown();
+            return -1;
+        }
+    }
+
     // Main loop
     const double targetFrameTime = 1.0 / 60.0;  // For 60 FPS
     
@@ -162,22 +257,38 @@ int main() {
         // Update camera zoom and position
         camera_update(&camera, deltaTime);
 
+        if (capturing) {
+            frame_capture_begin(&capture);
+        }
+
         world_render(&world, &camera);
 
-        glfwSwapBuffers(window);
+        if (capturing) {
+            frame_capture_end(&capture);
+            if (captureFrames > 0 && capture.frame >= (uint64_t)captureFrames) {
+                glfwSetWindowShouldClose(window, true);
+            }
+        } else {
+            glfwSwapBuffers(window);
+        }
         
         glfwPollEvents();
         
-        // Frame limiting
-        while (glfwGetTime() - currentFrame < targetFrameTime) {
+        // Frame limiting, capture runs as fast as the readback allows
+        while (!capturing && glfwGetTime() - currentFrame < targetFrameTime) {
             // Busy-wait or could use a sleep for better CPU usage
         }
     }
 
     // Cleanup
+    if (capturing) {
+        frame_capture_finish(&capture);
+        frame_capture_cleanup(&capture);
+    }
     world_cleanup(&world);
     glfwDestroyWindow(window);
     glfwTerminate();
+    job_system_shutdown();
 
     return 0;
 }
@@ -0,0 +1,138 @@
+#include "particle_activity.h"
+#include "shader.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Matches struct TileState in the compute shaders (std430)
+typedef struct {
+    float bounds[4];  // min.xy, max.xy
+    float maxSpeed;
+    unsigned int count;
+    unsigned int padding[2];
+} TileState;
+
+void particle_activity_init(ActiveSet* set, int maxTiles) {
+    memset(set, 0, sizeof(*set));
+    set->enabled = false;
+    set->restSpeed = ACTIVITY_REST_SPEED;
+    set->maxTiles = maxTiles > 0 ? maxTiles : 1;
+
+    glGenBuffers(1, &set->tileBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, set->tileBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, set->maxTiles * sizeof(TileState), NULL, GL_DYNAMIC_COPY);
+
+    glGenBuffers(1, &set->listBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, set->listBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, set->maxTiles * sizeof(unsigned int), NULL, GL_DYNAMIC_COPY);
+
+    // num_groups_x is the active tile count, y and z stay 1
+    glGenBuffers(1, &set->dispatchBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, set->dispatchBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, 3 * sizeof(unsigned int), NULL, GL_DYNAMIC_COPY);
+
+    glGenBuffers(ACTIVITY_READBACK_FRAMES, set->readbackBuffers);
+    for (int i = 0; i < ACTIVITY_READBACK_FRAMES; i++) {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, set->readbackBuffers[i]);
+        glBufferData(GL_COPY_WRITE_BUFFER, sizeof(unsigned int), NULL, GL_STREAM_READ);
+    }
+
+    char* buildSource = read_shader_file("shaders/particle_activity.comp");
+    if (!buildSource) {
+        fprintf(stderr, "Failed to load activity shader source\n");
+        return;
+    }
+
+    unsigned int buildShader = compile_shader(buildSource, GL_COMPUTE_SHADER);
+    set->buildProgram = glCreateProgram();
+    glAttachShader(set->buildProgram, buildShader);
+    glLinkProgram(set->buildProgram);
+    check_program_linking(set->buildProgram, "Activity");
+    glDeleteShader(buildShader);
+    free(buildSource);
+}
+
+// Pick up the active tile count from a few frames ago, never wait for it.
+// An unsignaled fence stays, the slot is reused once it signals.
+static void poll_readback(ActiveSet* set, int slot) {
+    GLsync fence = set->fences[slot];
+    if (!fence) {
+        return;
+    }
+
+    GLenum status = glClientWaitSync(fence, 0, 0);
+    if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+        return;
+    }
+
+    unsigned int activeTiles = 0;
+    glBindBuffer(GL_COPY_READ_BUFFER, set->readbackBuffers[slot]);
+    glGetBufferSubData(GL_COPY_READ_BUFFER, 0, sizeof(activeTiles), &activeTiles);
+    set->activeTiles = (int)activeTiles;
+    set->totalTiles = set->readbackTotals[slot];
+
+    glDeleteSync(fence);
+    set->fences[slot] = NULL;
+}
+
+void particle_activity_build(ActiveSet* set, int totalTiles, const float* mousePos,
+                             float forceRadius, bool wakeAll, bool countResting) {
+    int slot = set->frame % ACTIVITY_READBACK_FRAMES;
+    poll_readback(set, slot);
+    if (!set->fences[slot]) {
+        set->readbackTotals[slot] = totalTiles;
+    }
+
+    unsigned int args[3] = { 0, 1, 1 };
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, set->dispatchBuffer);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(args), args);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, set->tileBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 7, set->listBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 8, set->dispatchBuffer);
+    if (totalTiles <= 0) {
+        return;
+    }
+
+    // One thread per tile, cost is independent of the particle count
+    glUseProgram(set->buildProgram);
+    glUniform1ui(glGetUniformLocation(set->buildProgram, "tile_count"), totalTiles);
+    glUniform2fv(glGetUniformLocation(set->buildProgram, "mouse_pos"), 1, mousePos);
+    glUniform1f(glGetUniformLocation(set->buildProgram, "force_radius"), forceRadius);
+    glUniform1f(glGetUniformLocation(set->buildProgram, "rest_speed"), set->restSpeed);
+    glUniform1i(glGetUniformLocation(set->buildProgram, "wake_all"), wakeAll);
+    glUniform1i(glGetUniformLocation(set->buildProgram, "count_resting"), countResting);
+    glDispatchCompute((totalTiles + ACTIVITY_LOCAL_SIZE - 1) / ACTIVITY_LOCAL_SIZE, 1, 1);
+
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+}
+
+void particle_activity_dispatch(ActiveSet* set) {
+    int slot = set->frame % ACTIVITY_READBACK_FRAMES;
+
+    glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, set->dispatchBuffer);
+    glDispatchComputeIndirect(0);
+
+    // Skip the readback while the slot's previous copy is still in flight
+    if (!set->fences[slot]) {
+        glBindBuffer(GL_COPY_READ_BUFFER, set->dispatchBuffer);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, set->readbackBuffers[slot]);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, sizeof(unsigned int));
+        set->fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+    set->frame++;
+}
+
+void particle_activity_cleanup(ActiveSet* set) {
+    for (int i = 0; i < ACTIVITY_READBACK_FRAMES; i++) {
+        if (set->fences[i]) {
+            glDeleteSync(set->fences[i]);
+            set->fences[i] = NULL;
+        }
+    }
+    glDeleteBuffers(1, &set->tileBuffer);
+    glDeleteBuffers(1, &set->listBuffer);
+    glDeleteBuffers(1, &set->dispatchBuffer);
+    glDeleteBuffers(ACTIVITY_READBACK_FRAMES, set->readbackBuffers);
+    glDeleteProgram(set->buildProgram);
+}
@@ -0,0 +1,163 @@
+#include "particle_export.h"
+#include "particle_export_format.h"
+#include <stdio.h>
+#include <string.h>
+
+static size_t round_up(size_t value, size_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+void particle_export_init(ParticleExporter* exporter, int capacity) {
+    memset(exporter, 0, sizeof(*exporter));
+    exporter->capacity = capacity;
+}
+
+static bool open_export(ParticleExporter* exporter) {
+    size_t arrayBytes = round_up((size_t)exporter->capacity * sizeof(vec2), 64);
+    size_t slotStride = sizeof(ParticleExportSlot) + 2 * arrayBytes;
+    size_t firstSlot = round_up(sizeof(ParticleExportHeader), 64);
+    size_t size = firstSlot + PARTICLE_EXPORT_SLOTS * slotStride;
+
+    if (!platform_shared_memory_create(&exporter->shm, PARTICLE_EXPORT_NAME, size)) {
+        fprintf(stderr, "Failed to create shared memory %s (%zu bytes)\n", PARTICLE_EXPORT_NAME, size);
+        return false;
+    }
+
+    // Consumers check magic last, fill in everything else first
+    ParticleExportHeader* header = (ParticleExportHeader*)exporter->shm.memory;
+    memset(header, 0, firstSlot);
+    header->version = PARTICLE_EXPORT_VERSION;
+    header->layout = PARTICLE_EXPORT_POSITIONS | PARTICLE_EXPORT_VELOCITIES;
+    header->slotCount = PARTICLE_EXPORT_SLOTS;
+    header->slotCapacity = exporter->capacity;
+    header->slotStride = slotStride;
+    header->firstSlot = firstSlot;
+    header->positionOffset = sizeof(ParticleExportSlot);
+    header->velocityOffset = sizeof(ParticleExportSlot) + arrayBytes;
+    for (uint32_t i = 0; i < PARTICLE_EXPORT_SLOTS; i++) {
+        ParticleExportSlot* slot = particle_export_slot(header, i);
+        memset(slot, 0, sizeof(*slot));
+    }
+    atomic_store_explicit(&header->latestFrame, 0, memory_order_relaxed);
+    atomic_store_explicit(&header->latestSlot, 0, memory_order_relaxed);
+    atomic_store_explicit(&header->alive, 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    header->magic = PARTICLE_EXPORT_MAGIC;
+
+    // Readbacks mirror the slot arrays: positions, then velocities
+    glGenBuffers(PARTICLE_EXPORT_READBACKS, exporter->readbackBuffers);
+    for (int i = 0; i < PARTICLE_EXPORT_READBACKS; i++) {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, exporter->readbackBuffers[i]);
+        glBufferData(GL_COPY_WRITE_BUFFER, 2 * arrayBytes, NULL, GL_STREAM_READ);
+        exporter->fences[i] = NULL;
+    }
+
+    exporter->header = header;
+    exporter->frame = 0;
+    exporter->published = 0;
+    exporter->dropped = 0;
+    printf("Publishing particles to %s, %d per frame, %.1f MB\n",
+           PARTICLE_EXPORT_NAME, exporter->capacity, size / (1024.0 * 1024.0));
+    return true;
+}
+
+static void close_export(ParticleExporter* exporter) {
+    if (!exporter->header) {
+        return;
+    }
+    for (int i = 0; i < PARTICLE_EXPORT_READBACKS; i++) {
+        if (exporter->fences[i]) {
+            glDeleteSync(exporter->fences[i]);
+            exporter->fences[i] = NULL;
+        }
+    }
+    glDeleteBuffers(PARTICLE_EXPORT_READBACKS, exporter->readbackBuffers);
+
+    // Consumers that still have the block mapped see the engine leave
+    atomic_store_explicit(&exporter->header->alive, 0, memory_order_release);
+    platform_shared_memory_close(&exporter->shm, true);
+    exporter->header = NULL;
+}
+
+// Copy a finished readback into the next ring slot under its seqlock
+static void publish(ParticleExporter* exporter, int readback) {
+    ParticleExportHeader* header = exporter->header;
+    uint32_t index = (atomic_load_explicit(&header->latestSlot, memory_order_relaxed) + 1) % header->slotCount;
+    ParticleExportSlot* slot = particle_export_slot(header, index);
+    unsigned char* base = (unsigned char*)slot;
+    size_t count = exporter->readbackCounts[readback];
+    double start = platform_time_seconds();
+
+    uint32_t sequence = atomic_load_explicit(&slot->sequence, memory_order_relaxed);
+    atomic_store_explicit(&slot->sequence, sequence + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    glBindBuffer(GL_COPY_READ_BUFFER, exporter->readbackBuffers[readback]);
+    glGetBufferSubData(GL_COPY_READ_BUFFER, 0, count * sizeof(vec2), base + header->positionOffset);
+    glGetBufferSubData(GL_COPY_READ_BUFFER, header->velocityOffset - header->positionOffset,
+                       count * sizeof(vec2), base + header->velocityOffset);
+    slot->frame = exporter->readbackFrames[readback];
+    slot->count = count;
+    slot->time = start;
+
+    atomic_store_explicit(&slot->sequence, sequence + 2, memory_order_release);
+    atomic_store_explicit(&header->latestSlot, index, memory_order_relaxed);
+    atomic_store_explicit(&header->latestFrame, slot->frame, memory_order_release);
+
+    exporter->publishTimeMs = (float)((platform_time_seconds() - start) * 1000.0);
+    exporter->published++;
+}
+
+void particle_export_frame(ParticleExporter* exporter, const ParticleSystem* ps) {
+    if (!exporter->enabled) {
+        close_export(exporter);
+        return;
+    }
+    if (!exporter->header && !open_export(exporter)) {
+        exporter->enabled = false;
+        return;
+    }
+
+    int readback = exporter->frame % PARTICLE_EXPORT_READBACKS;
+    GLsync fence = exporter->fences[readback];
+    if (fence) {
+        GLenum status = glClientWaitSync(fence, 0, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+            // GPU is behind, skip this frame rather than stall on it
+            exporter->dropped++;
+            return;
+        }
+        publish(exporter, readback);
+        glDeleteSync(fence);
+        exporter->fences[readback] = NULL;
+    }
+
+    // Gather the groups' active ranges into one packed run per array
+    GLintptr velocityBase = exporter->header->velocityOffset - exporter->header->positionOffset;
+    int written = 0;
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, exporter->readbackBuffers[readback]);
+    for (int i = 0; i < ps->tableCount && written < exporter->capacity; i++) {
+        int count = ps->drawCounts[i];
+        if (count > exporter->capacity - written) {
+            count = exporter->capacity - written;
+        }
+        GLintptr source = (GLintptr)ps->drawFirsts[i] * sizeof(vec2);
+        glBindBuffer(GL_COPY_READ_BUFFER, ps->positionBuffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, source,
+                            written * sizeof(vec2), count * sizeof(vec2));
+        glBindBuffer(GL_COPY_READ_BUFFER, ps->velocityBuffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, source,
+                            velocityBase + written * sizeof(vec2), count * sizeof(vec2));
+        written += count;
+    }
+
+    exporter->fences[readback] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    exporter->readbackCounts[readback] = written;
+    exporter->readbackFrames[readback] = exporter->frame;
+    exporter->frame++;
+}
+
+void particle_export_cleanup(ParticleExporter* exporter) {
+    close_export(exporter);
+}
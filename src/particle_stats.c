@@ -0,0 +1,249 @@
+#include "particle_stats.h"
+#include "shader.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <float.h>
+#include <math.h>
+#include "simd_kernels.h"
+#include "job_system.h"
+
+#define STATS_MAX_RANGES 64
+// Smallest range worth handing to its own job
+#define STATS_MIN_RANGE 4096
+
+// Matches struct StatsPartial in the compute shaders (std430)
+typedef struct {
+    float minPos[2];
+    float maxPos[2];
+    float sumPos[2];
+    float kinetic;
+    float maxSpeed;
+    unsigned int count;     // Particles in the sums, deleted ones are left out
+    unsigned int padding;   // std430 rounds the struct up to its vec2 alignment
+} StatsPartial;
+
+typedef struct {
+    StatsPartial result;
+    unsigned int histogram[STATS_HISTOGRAM_BINS];
+} StatsReadback;
+
+static void stats_from_partial(ParticleStats* stats, const StatsPartial* partial,
+                               const unsigned int* histogram) {
+    int count = (int)partial->count;
+    stats->count = count;
+    stats->kineticEnergy = partial->kinetic;
+    stats->centerOfMass[0] = count > 0 ? partial->sumPos[0] / count : 0.0f;
+    stats->centerOfMass[1] = count > 0 ? partial->sumPos[1] / count : 0.0f;
+    stats->boundsMin[0] = partial->minPos[0];
+    stats->boundsMin[1] = partial->minPos[1];
+    stats->boundsMax[0] = partial->maxPos[0];
+    stats->boundsMax[1] = partial->maxPos[1];
+    stats->maxSpeed = partial->maxSpeed;
+    memcpy(stats->histogram, histogram, sizeof(stats->histogram));
+    stats->valid = count > 0;
+}
+
+// Partials for n workgroups, then every level of the 256-way tree above them
+static int partial_capacity_for(int maxWorkGroups) {
+    int total = maxWorkGroups;
+    int n = maxWorkGroups;
+    while (n > 1) {
+        n = (n + STATS_LOCAL_SIZE - 1) / STATS_LOCAL_SIZE;
+        total += n;
+    }
+    return total > 0 ? total : 1;
+}
+
+void particle_stats_init(StatsReducer* stats, int maxWorkGroups) {
+    memset(stats, 0, sizeof(*stats));
+    stats->enabled = true;
+    stats->partialCapacity = partial_capacity_for(maxWorkGroups);
+
+    glGenBuffers(1, &stats->partialBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, stats->partialBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, stats->partialCapacity * sizeof(StatsPartial), NULL, GL_DYNAMIC_COPY);
+
+    glGenBuffers(1, &stats->histogramBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, stats->histogramBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, STATS_HISTOGRAM_BINS * sizeof(unsigned int), NULL, GL_DYNAMIC_COPY);
+
+    glGenBuffers(STATS_READBACK_FRAMES, stats->readbackBuffers);
+    for (int i = 0; i < STATS_READBACK_FRAMES; i++) {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, stats->readbackBuffers[i]);
+        glBufferData(GL_COPY_WRITE_BUFFER, sizeof(StatsReadback), NULL, GL_STREAM_READ);
+    }
+
+    char* reduceSource = read_shader_file("shaders/particle_stats.comp");
+    if (!reduceSource) {
+        fprintf(stderr, "Failed to load stats shader source\n");
+        stats->enabled = false;
+        return;
+    }
+
+    unsigned int reduceShader = compile_shader(reduceSource, GL_COMPUTE_SHADER);
+    stats->reduceProgram = glCreateProgram();
+    glAttachShader(stats->reduceProgram, reduceShader);
+    glLinkProgram(stats->reduceProgram);
+    check_program_linking(stats->reduceProgram, "Stats");
+    glDeleteShader(reduceShader);
+    free(reduceSource);
+}
+
+void particle_stats_begin(StatsReducer* stats) {
+    unsigned int zero = 0;
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, stats->histogramBuffer);
+    glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, stats->partialBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, stats->histogramBuffer);
+}
+
+// Pick up a finished readback from a few frames ago, never wait for it.
+// Returns false while the GPU still owns the slot.
+static bool poll_readback(StatsReducer* stats, int slot) {
+    GLsync fence = stats->fences[slot];
+    if (!fence) {
+        return true;
+    }
+
+    GLenum status = glClientWaitSync(fence, 0, 0);
+    if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+        return false;
+    }
+
+    StatsReadback readback;
+    glBindBuffer(GL_COPY_READ_BUFFER, stats->readbackBuffers[slot]);
+    glGetBufferSubData(GL_COPY_READ_BUFFER, 0, sizeof(readback), &readback);
+    stats_from_partial(&stats->latest, &readback.result, readback.histogram);
+
+    glDeleteSync(fence);
+    stats->fences[slot] = NULL;
+    return true;
+}
+
+void particle_stats_reduce(StatsReducer* stats, int numWorkGroups) {
+    if (!stats->enabled || numWorkGroups <= 0) {
+        return;
+    }
+
+    // A slot still in flight is left alone, this frame's stats are dropped
+    int slot = stats->frame % STATS_READBACK_FRAMES;
+    stats->frame++;
+    if (!poll_readback(stats, slot)) {
+        return;
+    }
+
+    // Fold partials 256:1 per pass until a single one is left
+    glUseProgram(stats->reduceProgram);
+    GLint inputOffsetLoc = glGetUniformLocation(stats->reduceProgram, "input_offset");
+    GLint outputOffsetLoc = glGetUniformLocation(stats->reduceProgram, "output_offset");
+    GLint inputCountLoc = glGetUniformLocation(stats->reduceProgram, "input_count");
+
+    int offset = 0;
+    int n = numWorkGroups;
+    while (n > 1) {
+        int groups = (n + STATS_LOCAL_SIZE - 1) / STATS_LOCAL_SIZE;
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        glUniform1ui(inputOffsetLoc, offset);
+        glUniform1ui(outputOffsetLoc, offset + n);
+        glUniform1ui(inputCountLoc, n);
+        glDispatchCompute(groups, 1, 1);
+        offset += n;
+        n = groups;
+    }
+
+    // Only the final partial and the histogram cross to the host
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    glBindBuffer(GL_COPY_READ_BUFFER, stats->partialBuffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, stats->readbackBuffers[slot]);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+                        offset * sizeof(StatsPartial), 0, sizeof(StatsPartial));
+    glBindBuffer(GL_COPY_READ_BUFFER, stats->histogramBuffer);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+                        0, sizeof(StatsPartial), STATS_HISTOGRAM_BINS * sizeof(unsigned int));
+
+    stats->fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+void particle_stats_cleanup(StatsReducer* stats) {
+    for (int i = 0; i < STATS_READBACK_FRAMES; i++) {
+        if (stats->fences[i]) {
+            glDeleteSync(stats->fences[i]);
+            stats->fences[i] = NULL;
+        }
+    }
+    glDeleteBuffers(1, &stats->partialBuffer);
+    glDeleteBuffers(1, &stats->histogramBuffer);
+    glDeleteBuffers(STATS_READBACK_FRAMES, stats->readbackBuffers);
+    glDeleteProgram(stats->reduceProgram);
+}
+
+// CPU reduction
+
+typedef struct {
+    const vec2* positions;
+    const vec2* velocities;
+    int begin;
+    int end;
+    SimdStatsResult result;
+} StatsRange;
+
+// Job callback over a range of StatsRange indices
+static void reduce_ranges(void* data, int begin, int end) {
+    StatsRange* ranges = (StatsRange*)data;
+    for (int i = begin; i < end; i++) {
+        StatsRange* range = &ranges[i];
+        simd_get()->reduce_stats(range->positions + range->begin, range->velocities + range->begin,
+                                 range->end - range->begin, &range->result);
+    }
+}
+
+void particle_stats_reduce_cpu(const vec2* positions, const vec2* velocities, int count, ParticleStats* out) {
+    memset(out, 0, sizeof(*out));
+    if (count <= 0) {
+        return;
+    }
+
+    // SIMD lanes -> per-range partials on the job system -> merged here
+    int rangeCount = count / STATS_MIN_RANGE;
+    if (rangeCount > STATS_MAX_RANGES) rangeCount = STATS_MAX_RANGES;
+    if (rangeCount < 1) rangeCount = 1;
+
+    StatsRange ranges[STATS_MAX_RANGES];
+    int perRange = count / rangeCount;
+    for (int r = 0; r < rangeCount; r++) {
+        ranges[r].positions = positions;
+        ranges[r].velocities = velocities;
+        ranges[r].begin = r * perRange;
+        ranges[r].end = (r == rangeCount - 1) ? count : (r + 1) * perRange;
+    }
+    job_parallel_for(0, rangeCount, 1, reduce_ranges, ranges);
+
+    double sumPos[2] = {0.0, 0.0};
+    double kinetic = 0.0;
+    float maxSpeedSq = 0.0f;
+    out->boundsMin[0] = out->boundsMin[1] = FLT_MAX;
+    out->boundsMax[0] = out->boundsMax[1] = -FLT_MAX;
+    for (int t = 0; t < rangeCount; t++) {
+        SimdStatsResult* r = &ranges[t].result;
+        sumPos[0] += r->sumPos[0];
+        sumPos[1] += r->sumPos[1];
+        kinetic += r->kinetic;
+        maxSpeedSq = fmaxf(maxSpeedSq, r->maxSpeedSq);
+        out->boundsMin[0] = fminf(out->boundsMin[0], r->minPos[0]);
+        out->boundsMin[1] = fminf(out->boundsMin[1], r->minPos[1]);
+        out->boundsMax[0] = fmaxf(out->boundsMax[0], r->maxPos[0]);
+        out->boundsMax[1] = fmaxf(out->boundsMax[1], r->maxPos[1]);
+        for (int b = 0; b < STATS_HISTOGRAM_BINS; b++) {
+            out->histogram[b] += r->histogram[b];
+        }
+    }
+
+    out->count = count;
+    out->kineticEnergy = (float)kinetic;
+    out->centerOfMass[0] = (float)(sumPos[0] / count);
+    out->centerOfMass[1] = (float)(sumPos[1] / count);
+    out->maxSpeed = sqrtf(maxSpeedSq);
+    out->valid = true;
+}
@@ -1,105 +1,93 @@
 #include "particle_system.h"
 #include "shader.h"
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <xmmintrin.h>  // SSE
-#include <emmintrin.h>  // SSE2
+#include <string.h>
+#include <math.h>
+#include "simd_kernels.h"
+#include "job_system.h"
+#include "arena.h"
 
+// Pool size. Groups start on PARTICLE_GROUP_ALIGNMENT boundaries, so one
+// system spanning the pool holds 64,999,424 of these.
 #define MAX_PARTICLES 65000000
+// Particles per random seed, keeps the layout independent of the stream chunk size
+#define PARTICLE_GEN_CHUNK 65536
+// Particles generated per job and uploaded per glBufferSubData
+#define PARTICLE_STREAM_CHUNK (16 * PARTICLE_GEN_CHUNK)
+// Host chunks in flight between the generators and the uploader
+#define PARTICLE_STREAM_SLOTS 8
+#define PARTICLE_STREAM_UPLOADS_PER_FRAME 2
 
-static inline uint32_t xorshift32(uint32_t* state) {
-    uint32_t x = *state;
-    x ^= x << 13;
-    x ^= x >> 17;
-    x ^= x << 5;
-    *state = x;
-    return x;
-}
-
-static void init_particle_positions(vec2* positions, int numParticles) {
-    // Initialize multiple states for parallel random generation
-    __m128i state = _mm_set_epi32(
-        0xDEADBEEF,  // Different prime numbers/seeds
-        0xB00B1E55,  // for each lane
-        0xBADF00D5,
-        0xCAFEBABE
-    );
-    
-    // Change scale and offset to center around (0,0)
-    // Using -1.0 to 1.0 range first, then scaling to desired size
-    __m128 scale = _mm_set1_ps(2.0f / (float)UINT32_MAX);  // Scale to -1 to 1 range
-    __m128 world_scale = _mm_set1_ps(20.0f);  // Then scale to world coordinates
-    
-    int aligned_count = (numParticles / 4) * 4;
-    for (int i = 0; i < aligned_count; i += 4) {
-        // Generate random numbers using XOR-shift (same as before)
-        __m128i rx = state;
-        rx = _mm_xor_si128(rx, _mm_slli_epi32(rx, 13));
-        rx = _mm_xor_si128(rx, _mm_srli_epi32(rx, 17));
-        rx = _mm_xor_si128(rx, _mm_slli_epi32(rx, 5));
-        state = rx;
-        
-        __m128i ry = rx;
-        ry = _mm_xor_si128(ry, _mm_slli_epi32(ry, 13));
-        ry = _mm_xor_si128(ry, _mm_srli_epi32(ry, 17));
-        ry = _mm_xor_si128(ry, _mm_slli_epi32(ry, 5));
-        
-        // Convert to floats and scale to -1 to 1 range
-        __m128 fx = _mm_mul_ps(_mm_cvtepi32_ps(rx), scale);
-        __m128 fy = _mm_mul_ps(_mm_cvtepi32_ps(ry), scale);
-        
-        // Scale to world coordinates (-20 to 20)
-        fx = _mm_mul_ps(fx, world_scale);
-        fy = _mm_mul_ps(fy, world_scale);
-        
-        // Store interleaved x,y coordinates
-        __m128 xy0 = _mm_unpacklo_ps(fx, fy);
-        __m128 xy1 = _mm_unpackhi_ps(fx, fy);
-        
-        _mm_store_ps((float*)&positions[i], xy0);
-        _mm_store_ps((float*)&positions[i + 2], xy1);
-    }
-    
-    // Handle remaining particles
-    uint32_t scalar_state = 0xCAFEBABE;
-    for (int i = aligned_count; i < numParticles; i++) {
-        uint32_t rx = xorshift32(&scalar_state);
-        uint32_t ry = xorshift32(&scalar_state);
-        
-        // Scale to -20 to 20 range centered at origin
-        positions[i][0] = ((rx / (float)UINT32_MAX) * 2.0f - 1.0f) * 20.0f;
-        positions[i][1] = ((ry / (float)UINT32_MAX) * 2.0f - 1.0f) * 20.0f;
-    }
-}
+// Layout of glMultiDrawArraysIndirect commands
+typedef struct {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint first;
+    GLuint baseInstance;
+} DrawCommand;
 
-static void simd_zero_velocities(vec2* velocities, int numParticles) {
-    __m128 zero = _mm_setzero_ps();
-    
-    int aligned_count = (numParticles / 2) * 2;
-    for (int i = 0; i < aligned_count; i += 2) {
-        _mm_store_ps((float*)&velocities[i], zero);
-    }
-    
-    for (int i = aligned_count; i < numParticles; i++) {
-        velocities[i][0] = 0.0f;
-        velocities[i][1] = 0.0f;
-    }
-}
+// Per-instance attributes of a run, baseInstance selects its element
+typedef struct {
+    GLuint entry;       // Table entry, the fused pass reads its parameters
+    GLuint palette;     // Palette row, so the plain draw needs no storage block
+} DrawInstance;
+
+typedef struct {
+    vec2* positions;
+    vec2* velocities;
+    int groupId;
+    int first;      // First particle within the group
+    int count;
+    ParticleGroupDesc desc;
+    JobCounter generated;
+    JobCounter done;        // Generation and, if seeding, the stats after it
+    bool seedStats;         // Scheduled while nothing was active, stats follow the generation
+    ParticleStats stats;
+} StreamChunk;
+
+// Factors over the group parameters, species 0 leaves a group as it is
+static const ParticleSpecies defaultSpecies[] = {
+    { "Default",  1.0f,  1.0f, 1.0f,    -1 },
+    { "Heavy",    4.0f,  1.0f, 1.0f,    COLORMAP_INFERNO },
+    { "Light",    0.5f,  1.0f, 0.9990f, COLORMAP_VIRIDIS },
+    { "Skittish", 1.0f, -0.5f, 0.9995f, COLORMAP_RAINBOW },
+};
 
-static void init_particle_buffers(ParticleSystem* ps, vec2* positions, vec2* velocities) {
+// Chunks are generated and uploaded in sequence order, so every group
+// fills its range front to back
+struct ParticleStreamer {
+    Arena arena;             // Backs the chunk staging arrays
+    StreamChunk chunks[PARTICLE_STREAM_SLOTS];
+    unsigned int scheduled;  // Sequence number of the next chunk to generate
+    unsigned int uploaded;   // Sequence number of the next chunk to upload
+};
+
+static void init_particle_buffers(ParticleSystem* ps) {
     glGenBuffers(1, &ps->positionBuffer);
     glGenBuffers(1, &ps->velocityBuffer);
     glGenBuffers(1, &ps->velocityMagBuffer);
 
     glBindBuffer(GL_SHADER_STORAGE_BUFFER, ps->positionBuffer);
-    glBufferData(GL_SHADER_STORAGE_BUFFER, ps->numParticles * sizeof(vec2), positions, GL_DYNAMIC_DRAW);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, ps->numParticles * sizeof(vec2), NULL, GL_DYNAMIC_DRAW);
 
     glBindBuffer(GL_SHADER_STORAGE_BUFFER, ps->velocityBuffer);
-    glBufferData(GL_SHADER_STORAGE_BUFFER, ps->numParticles * sizeof(vec2), velocities, GL_DYNAMIC_DRAW);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, ps->numParticles * sizeof(vec2), NULL, GL_DYNAMIC_DRAW);
 
     glBindBuffer(GL_SHADER_STORAGE_BUFFER, ps->velocityMagBuffer);
     glBufferData(GL_SHADER_STORAGE_BUFFER, ps->numParticles * sizeof(float), NULL, GL_DYNAMIC_DRAW);
 
+    // Each run is drawn as one instance whose baseInstance is its table
+    // entry, the per-instance attributes hand the entry and palette to the vertices
+    glGenBuffers(1, &ps->drawInstanceBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, ps->drawInstanceBuffer);
+    glBufferData(GL_ARRAY_BUFFER, MAX_PARTICLE_RUNS * sizeof(DrawInstance), NULL, GL_DYNAMIC_DRAW);
+
+    glGenBuffers(1, &ps->drawCommandBuffer);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, ps->drawCommandBuffer);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, MAX_PARTICLE_RUNS * sizeof(DrawCommand), NULL, GL_DYNAMIC_DRAW);
+
     glGenVertexArrays(1, &ps->particleVAO);
     glBindVertexArray(ps->particleVAO);
     
@@ -110,107 +98,829 @@ static void init_particle_buffers(ParticleSystem* ps, vec2* positions, vec2* vel
     glBindBuffer(GL_ARRAY_BUFFER, ps->velocityMagBuffer);
     glVertexAttribPointer(1, 1, GL_FLOAT, GL_FALSE, sizeof(float), (void*)0);
     glEnableVertexAttribArray(1);
+
+    glBindBuffer(GL_ARRAY_BUFFER, ps->drawInstanceBuffer);
+    glVertexAttribIPointer(2, 1, GL_UNSIGNED_INT, sizeof(DrawInstance), (void*)offsetof(DrawInstance, entry));
+    glVertexAttribDivisor(2, 1);
+    glEnableVertexAttribArray(2);
+    glVertexAttribIPointer(3, 1, GL_UNSIGNED_INT, sizeof(DrawInstance), (void*)offsetof(DrawInstance, palette));
+    glVertexAttribDivisor(3, 1);
+    glEnableVertexAttribArray(3);
+
+    // The fused pass reads the SSBOs itself, only the instance data are attributes
+    glGenVertexArrays(1, &ps->pullVAO);
+    glBindVertexArray(ps->pullVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, ps->drawInstanceBuffer);
+    glVertexAttribIPointer(2, 1, GL_UNSIGNED_INT, sizeof(DrawInstance), (void*)offsetof(DrawInstance, entry));
+    glVertexAttribDivisor(2, 1);
+    glEnableVertexAttribArray(2);
+    glVertexAttribIPointer(3, 1, GL_UNSIGNED_INT, sizeof(DrawInstance), (void*)offsetof(DrawInstance, palette));
+    glVertexAttribDivisor(3, 1);
+    glEnableVertexAttribArray(3);
+    glBindVertexArray(0);
+
+    glGenBuffers(1, &ps->groupTableBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, ps->groupTableBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, MAX_PARTICLE_RUNS * sizeof(ParticleGroupGPU), NULL, GL_DYNAMIC_DRAW);
+}
+
+static void init_timer_queries(ParticleSystem* ps) {
+    glGenQueries(PARTICLE_TIMER_FRAMES, ps->stepQueries);
+    glGenQueries(PARTICLE_TIMER_FRAMES, ps->drawQueries);
+    ps->queryFrame = 0;
+    ps->stepTimeMs = 0.0f;
+    ps->drawTimeMs = 0.0f;
+}
+
+// Collect the results of the slot we are about to reuse, without blocking
+static void collect_timer_queries(ParticleSystem* ps, int slot) {
+    if (ps->queryFrame < PARTICLE_TIMER_FRAMES) {
+        return;
+    }
+
+    GLint available = 0;
+    glGetQueryObjectiv(ps->drawQueries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available) {
+        return;
+    }
+
+    GLuint64 stepNs = 0;
+    GLuint64 drawNs = 0;
+    glGetQueryObjectui64v(ps->stepQueries[slot], GL_QUERY_RESULT, &stepNs);
+    glGetQueryObjectui64v(ps->drawQueries[slot], GL_QUERY_RESULT, &drawNs);
+    ps->stepTimeMs = stepNs / 1000000.0f;
+    ps->drawTimeMs = drawNs / 1000000.0f;
+}
+
+static bool kernel_config_equal(const ParticleKernelConfig* a, const ParticleKernelConfig* b) {
+    return a->collectStats == b->collectStats &&
+           a->integrator == b->integrator &&
+           a->localSize == b->localSize &&
+           a->particlesPerInvocation == b->particlesPerInvocation &&
+           a->sparse == b->sparse &&
+           a->fluid == b->fluid &&
+           a->flags == b->flags;
+}
+
+unsigned int particle_system_kernel_variant(ParticleSystem* ps, const ParticleKernelConfig* config) {
+    char localSize[16], perInvocation[16], integrator[16];
+    snprintf(localSize, sizeof(localSize), "%d", config->localSize);
+    snprintf(perInvocation, sizeof(perInvocation), "%d", config->particlesPerInvocation);
+    snprintf(integrator, sizeof(integrator), "%d", config->integrator);
+
+    ShaderDefine defines[] = {
+        {"LOCAL_SIZE", localSize},
+        {"PARTICLES_PER_INVOCATION", perInvocation},
+        {"COLLECT_STATS", config->collectStats ? "1" : "0"},
+        {"INTEGRATOR", integrator},
+        {"SPARSE_UPDATE", config->sparse ? "1" : "0"},
+        {"FLUID_COUPLING", config->fluid ? "1" : "0"},
+        {"PARTICLE_FLAGS", config->flags ? "1" : "0"},
+    };
+
+    return shader_variant_cache_get(&ps->computeVariants, defines, sizeof(defines) / sizeof(defines[0]));
+}
+
+unsigned int particle_system_kernel(ParticleSystem* ps) {
+    unsigned int program = particle_system_kernel_variant(ps, &ps->kernel);
+    if (!program) {
+        // Fall back to the kernel in use, the failure was reported once by the cache
+        ps->kernel = ps->activeKernel;
+        return ps->computeProgram;
+    }
+
+    ps->activeKernel = ps->kernel;
+    return program;
+}
+
+static ParticleStreamer* create_streamer(void) {
+    ParticleStreamer* streamer = (ParticleStreamer*)calloc(1, sizeof(ParticleStreamer));
+    if (!streamer) {
+        return NULL;
+    }
+
+    // Staging is rewritten constantly during loading, fault it in once on all workers
+    size_t chunkBytes = PARTICLE_STREAM_CHUNK * sizeof(vec2) + ARENA_ALIGNMENT;
+    if (!arena_init(&streamer->arena, 2 * PARTICLE_STREAM_SLOTS * chunkBytes, ARENA_HUGE_PAGES | ARENA_PREFAULT)) {
+        free(streamer);
+        return NULL;
+    }
+
+    for (int i = 0; i < PARTICLE_STREAM_SLOTS; i++) {
+        StreamChunk* chunk = &streamer->chunks[i];
+        chunk->positions = (vec2*)arena_alloc(&streamer->arena, PARTICLE_STREAM_CHUNK * sizeof(vec2));
+        chunk->velocities = (vec2*)arena_alloc(&streamer->arena, PARTICLE_STREAM_CHUNK * sizeof(vec2));
+    }
+    printf("Particle staging: %zu MB, %s\n", streamer->arena.capacity >> 20,
+           arena_page_kind_name(streamer->arena.pageKind));
+    return streamer;
+}
+
+static void destroy_streamer(ParticleStreamer* streamer) {
+    if (!streamer) {
+        return;
+    }
+
+    // Generators may still be writing into the chunks
+    for (int i = 0; i < PARTICLE_STREAM_SLOTS; i++) {
+        job_wait(&streamer->chunks[i].done);
+    }
+    arena_release(&streamer->arena);
+    free(streamer);
 }
 
 void particle_system_init(ParticleSystem* ps) {
     ps->numParticles = MAX_PARTICLES;
-    ps->count = ps->numParticles;  // Set count to match actual number of particles
+    ps->count = 0;  // Groups bring particles into the pool
+    ps->groupCount = 0;
+    ps->nextGroupId = 0;
+    ps->tableCount = 0;
+    ps->workGroupCount = 0;
     ps->mousePos[0] = 0.0f;
     ps->mousePos[1] = 0.0f;
     ps->deltaTime = 0.0f;
-    
-    // Initialize shaders
-    char* computeSource = read_shader_file("shaders/particle.comp");
-    char* vertexSource = read_shader_file("shaders/particle.vert");
-    char* fragmentSource = read_shader_file("shaders/particle.frag");
-
-    if (!computeSource || !vertexSource || !fragmentSource) {
-        free(computeSource);
-        free(vertexSource);
-        free(fragmentSource);
+    ps->forceRadius = 0.0f;
+    ps->fluid = NULL;
+    ps->fused = false;
+    ps->fusedSupported = false;
+    ps->fusedDrawn = false;
+    ps->flagsInUse = false;
+    ps->flagBuffer = 0;
+    ps->speciesBuffer = 0;
+    ps->vertexStorageBlocks = 0;
+    ps->tilesStale = true;
+    ps->computeProgram = 0;
+    ps->renderProgram = 0;
+
+    ps->speciesCount = (int)(sizeof(defaultSpecies) / sizeof(defaultSpecies[0]));
+    memcpy(ps->species, defaultSpecies, sizeof(defaultSpecies));
+
+    init_timer_queries(ps);
+
+    colormap_init(&ps->colormap);
+
+    init_particle_buffers(ps);
+
+    // Run starts add at most one partially filled workgroup each
+    int maxWorkGroups = (ps->numParticles + PARTICLE_MIN_LOCAL_SIZE - 1) / PARTICLE_MIN_LOCAL_SIZE + MAX_PARTICLE_RUNS;
+    particle_stats_init(&ps->stats, maxWorkGroups);
+    particle_activity_init(&ps->activity, maxWorkGroups);
+
+    ps->streamer = create_streamer();
+    if (!ps->streamer) {
+        fprintf(stderr, "Failed to allocate particle stream chunks\n");
+    }
+}
+
+// Plain or fused render pass. Only the fused pass integrates, so the
+// integrator is part of its key alone.
+static unsigned int render_program(ParticleSystem* ps, bool fused, bool flags) {
+    char integrator[16];
+    snprintf(integrator, sizeof(integrator), "%d", fused ? ps->kernel.integrator : 0);
+    ShaderDefine defines[] = {
+        {"FUSED_UPDATE", fused ? "1" : "0"},
+        {"INTEGRATOR", integrator},
+        {"PARTICLE_FLAGS", flags ? "1" : "0"},
+    };
+    return shader_variant_cache_get(&ps->renderVariants, defines, sizeof(defines) / sizeof(defines[0]));
+}
+
+void particle_system_load_shaders(ParticleSystem* ps) {
+    const char* renderPaths[2] = { "shaders/particle.vert", "shaders/particle.frag" };
+    GLenum renderTypes[2] = { GL_VERTEX_SHADER, GL_FRAGMENT_SHADER };
+    int renderLoaded = shader_variant_cache_init(&ps->renderVariants, "Render", renderPaths, renderTypes, 2);
+
+    const char* computePath = "shaders/particle.comp";
+    GLenum computeType = GL_COMPUTE_SHADER;
+    int computeLoaded = shader_variant_cache_init(&ps->computeVariants, "Compute", &computePath, &computeType, 1);
+
+    if (!computeLoaded || !renderLoaded) {
         fprintf(stderr, "Failed to load shader sources\n");
         return;
     }
 
-    // Compile and link shaders
-    unsigned int computeShader = compile_shader(computeSource, GL_COMPUTE_SHADER);
-    unsigned int vertexShader = compile_shader(vertexSource, GL_VERTEX_SHADER);
-    unsigned int fragmentShader = compile_shader(fragmentSource, GL_FRAGMENT_SHADER);
+    ps->kernel.collectStats = true;
+    ps->kernel.integrator = PARTICLE_INTEGRATOR_EULER;
+    ps->kernel.localSize = 256;
+    ps->kernel.particlesPerInvocation = 1;
+    ps->kernel.sparse = false;
+    ps->kernel.fluid = false;
+    ps->kernel.flags = false;
+    // Also what a failing variant falls back to, so the tiling stays valid
+    ps->activeKernel = ps->kernel;
+    ps->computeProgram = 0;
+    ps->computeProgram = particle_system_kernel(ps);
 
-    ps->computeProgram = glCreateProgram();
-    glAttachShader(ps->computeProgram, computeShader);
-    glLinkProgram(ps->computeProgram);
-    check_program_linking(ps->computeProgram, "Compute");
-    glDeleteShader(computeShader);
+    ps->renderProgram = render_program(ps, false, false);
 
-    ps->renderProgram = glCreateProgram();
-    glAttachShader(ps->renderProgram, vertexShader);
-    glAttachShader(ps->renderProgram, fragmentShader);
-    glLinkProgram(ps->renderProgram);
-    check_program_linking(ps->renderProgram, "Render");
-    
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
-    
-    free(computeSource);
-    free(vertexSource);
-    free(fragmentSource);
+    // Vertex shaders may have no storage blocks at all in GL 4.3, the fused
+    // pass needs positions, velocities and the group table
+    glGetIntegerv(GL_MAX_VERTEX_SHADER_STORAGE_BLOCKS, &ps->vertexStorageBlocks);
+    ps->fusedSupported = ps->vertexStorageBlocks >= 3;
+    if (!ps->fusedSupported) {
+        printf("Fused update unavailable, %d vertex shader storage blocks\n", ps->vertexStorageBlocks);
+    }
+}
 
-    // Initialize particle data
-    vec2* positions = (vec2*)malloc(ps->numParticles * sizeof(vec2));
-    vec2* velocities = (vec2*)malloc(ps->numParticles * sizeof(vec2));
+// The fused pass needs one more vertex storage block for the marks, without
+// it frozen particles would keep moving, so fall back to the compute pass
+static bool fused_active(const ParticleSystem* ps) {
+    return ps->fused && ps->fusedSupported && (!ps->flagsInUse || ps->vertexStorageBlocks >= 4);
+}
 
-    if (!positions || !velocities) {
-        free(positions);
-        free(velocities);
+void particle_system_enable_flags(ParticleSystem* ps) {
+    if (ps->flagBuffer) {
+        ps->flagsInUse = true;
         return;
     }
 
-    init_particle_positions(positions, ps->numParticles);
-    simd_zero_velocities(velocities, ps->numParticles);
-    init_particle_buffers(ps, positions, velocities);
+    // 65M particles only cost 65 MB as bytes, the update reads a quarter of a uint each
+    GLsizeiptr size = ((GLsizeiptr)ps->numParticles + 3) / 4 * 4;
+    glGenBuffers(1, &ps->flagBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, ps->flagBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, size, NULL, GL_DYNAMIC_DRAW);
+    ps->flagsInUse = true;
+    particle_system_clear_flags(ps);
+}
+
+void particle_system_clear_flags(ParticleSystem* ps) {
+    if (!ps->flagBuffer) {
+        return;
+    }
+    unsigned int zero = 0;
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, ps->flagBuffer);
+    glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+    // Resting tiles may hold thawed particles now
+    ps->tilesStale = true;
+}
 
-    free(positions);
-    free(velocities);
+// Per-system parameter table: each non-empty species run gets a contiguous
+// run of workgroups, so the kernel finds its parameters once per workgroup
+// and never branches on the species of a particle. More species only add
+// table entries and at most one partial workgroup each.
+static int run_active_count(const ParticleGroup* group, const SpeciesRun* run) {
+    // The budget scales every run by the same fraction, loading fills them in order
+    int requested = (int)((long long)run->capacity * group->count / group->capacity);
+    int loaded = group->loaded - run->offset;
+    loaded = loaded < 0 ? 0 : loaded > run->capacity ? run->capacity : loaded;
+    return requested < loaded ? requested : loaded;
+}
+
+static void refresh_active_count(ParticleSystem* ps) {
+    int total = 0;
+    for (int i = 0; i < ps->groupCount; i++) {
+        const ParticleGroup* group = &ps->groups[i];
+        for (int r = 0; r < group->runCount; r++) {
+            total += run_active_count(group, &group->runs[r]);
+        }
+    }
+    ps->count = total;
+}
+
+static int upload_group_table(ParticleSystem* ps) {
+    ParticleGroupGPU table[MAX_PARTICLE_RUNS];
+    DrawCommand commands[MAX_PARTICLE_RUNS];
+    DrawInstance instances[MAX_PARTICLE_RUNS];
+    // Tiles follow the kernel that actually runs, not the one requested
+    int tileSize = ps->activeKernel.localSize * ps->activeKernel.particlesPerInvocation;
+    int workGroups = 0;
+    int tableCount = 0;
+
+    for (int i = 0; i < ps->groupCount; i++) {
+        const ParticleGroup* group = &ps->groups[i];
+        for (int r = 0; r < group->runCount; r++) {
+            const SpeciesRun* run = &group->runs[r];
+            int count = run_active_count(group, run);
+            if (count <= 0) {
+                continue;
+            }
+
+            const ParticleSpecies* species = &ps->species[run->species];
+            ParticleGroupGPU* entry = &table[tableCount];
+            entry->offset = group->offset + run->offset;
+            entry->count = count;
+            entry->firstWorkGroup = workGroups;
+            entry->palette = species->palette >= 0 ? species->palette : group->desc.palette;
+            entry->attraction = group->desc.attraction * species->attraction / species->mass;
+            entry->damping = group->desc.damping * species->damping;
+            entry->invMass = 1.0f / species->mass;
+            entry->species = run->species;
+
+            ps->drawFirsts[tableCount] = entry->offset;
+            ps->drawCounts[tableCount] = count;
+            commands[tableCount].count = (GLuint)count;
+            commands[tableCount].instanceCount = 1;
+            commands[tableCount].first = entry->offset;
+            commands[tableCount].baseInstance = (GLuint)tableCount;
+            instances[tableCount].entry = (GLuint)tableCount;
+            instances[tableCount].palette = entry->palette;
+
+            workGroups += (count + tileSize - 1) / tileSize;
+            tableCount++;
+        }
+    }
+
+    // Any change moves tiles to other particles, so recorded tile state is stale
+    if (tableCount != ps->tableCount ||
+        memcmp(table, ps->uploadedTable, tableCount * sizeof(ParticleGroupGPU)) != 0) {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, ps->groupTableBuffer);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, tableCount * sizeof(ParticleGroupGPU), table);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, ps->drawCommandBuffer);
+        glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, tableCount * sizeof(DrawCommand), commands);
+        glBindBuffer(GL_ARRAY_BUFFER, ps->drawInstanceBuffer);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, tableCount * sizeof(DrawInstance), instances);
+        memcpy(ps->uploadedTable, table, tableCount * sizeof(ParticleGroupGPU));
+        ps->tilesStale = true;
+    }
+
+    ps->tableCount = tableCount;
+    ps->workGroupCount = workGroups;
+    return workGroups;
+}
+
+static void bind_fluid(ParticleSystem* ps) {
+    const FluidField* fluid = ps->fluid;
+    float uvScale, uvOffset;
+    fluid_uv_transform(fluid, &uvScale, &uvOffset);
+
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, fluid_velocity_texture(fluid));
+    // Later binds (colormap, grid, ImGui) assume unit 0 is active
+    glActiveTexture(GL_TEXTURE0);
+    glUniform1i(glGetUniformLocation(ps->computeProgram, "fluid_velocity"), 1);
+    glUniform1f(glGetUniformLocation(ps->computeProgram, "fluid_uv_scale"), uvScale);
+    glUniform1f(glGetUniformLocation(ps->computeProgram, "fluid_uv_offset"), uvOffset);
+    glUniform1f(glGetUniformLocation(ps->computeProgram, "fluid_extent"), fluid->extent);
+    glUniform1f(glGetUniformLocation(ps->computeProgram, "fluid_blend"), 1.0f - expf(-fluid->coupling * ps->deltaTime));
 }
 
 void particle_system_update(ParticleSystem* ps) {
-    glUseProgram(ps->computeProgram);
-    
-    glUniform1f(glGetUniformLocation(ps->computeProgram, "delta_time"), ps->deltaTime);
-    glUniform2fv(glGetUniformLocation(ps->computeProgram, "mouse_pos"), 1, ps->mousePos);
-    glUniform1i(glGetUniformLocation(ps->computeProgram, "num_particles"), ps->numParticles);
+    int slot = ps->queryFrame % PARTICLE_TIMER_FRAMES;
+    collect_timer_queries(ps, slot);
+
+    // Variant is compiled the first time a configuration is used. With an
+    // unlimited force every tile is in reach, so sparse updates need a radius.
+    // The flow can move any tile, so it also turns sparse updates off.
+    ps->kernel.collectStats = ps->stats.enabled;
+    ps->kernel.fluid = ps->fluid && ps->fluid->enabled;
+    ps->kernel.sparse = ps->activity.enabled && ps->forceRadius > 0.0f && !ps->kernel.fluid;
+    ps->kernel.flags = ps->flagsInUse;
+    if (!kernel_config_equal(&ps->kernel, &ps->activeKernel)) {
+        ps->computeProgram = particle_system_kernel(ps);
+        ps->tilesStale = true;
+    }
+    bool sparse = ps->activeKernel.sparse;
+    int numWorkGroups = upload_group_table(ps);
+
+    // Fused mode steps particles in the draw, the table above is all it needs.
+    // The stats, sparse tiles and fluid drag all live in the compute pass.
+    if (fused_active(ps)) {
+        ps->stats.latest.valid = false;
+        glBeginQuery(GL_TIME_ELAPSED, ps->stepQueries[slot]);
+        glEndQuery(GL_TIME_ELAPSED);
+        ps->tilesStale = true;
+        return;
+    }
 
     glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, ps->positionBuffer);
     glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, ps->velocityBuffer);
     glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, ps->velocityMagBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, ps->groupTableBuffer);
+    if (ps->activeKernel.flags) {
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, PARTICLE_FLAGS_BINDING, ps->flagBuffer);
+    }
+    if (ps->stats.enabled) {
+        particle_stats_begin(&ps->stats);
+    } else {
+        ps->stats.latest.valid = false;
+    }
+
+    glBeginQuery(GL_TIME_ELAPSED, ps->stepQueries[slot]);
+    if (sparse) {
+        particle_activity_build(&ps->activity, numWorkGroups, ps->mousePos, ps->forceRadius,
+                                ps->tilesStale, ps->stats.enabled);
+        ps->tilesStale = false;
+    }
 
-    int workGroupSize = 256;
-    int numWorkGroups = (ps->numParticles + workGroupSize - 1) / workGroupSize;
-    glDispatchCompute(numWorkGroups, 1, 1);
+    glUseProgram(ps->computeProgram);
+    glUniform1f(glGetUniformLocation(ps->computeProgram, "delta_time"), ps->deltaTime);
+    glUniform2fv(glGetUniformLocation(ps->computeProgram, "mouse_pos"), 1, ps->mousePos);
+    glUniform1f(glGetUniformLocation(ps->computeProgram, "force_radius"), ps->forceRadius);
+    glUniform1ui(glGetUniformLocation(ps->computeProgram, "group_count"), ps->tableCount);
+    glUniform1f(glGetUniformLocation(ps->computeProgram, "histogram_max_speed"), STATS_HISTOGRAM_MAX_SPEED);
+    if (ps->activeKernel.fluid && ps->fluid) {
+        bind_fluid(ps);
+    }
+
+    // One dispatch covers every group, workgroups never straddle two groups
+    if (sparse) {
+        particle_activity_dispatch(&ps->activity);
+    } else {
+        glDispatchCompute(numWorkGroups, 1, 1);
+    }
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    particle_stats_reduce(&ps->stats, numWorkGroups);
+    glEndQuery(GL_TIME_ELAPSED);
 
     glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
 }
 
 void particle_system_render(ParticleSystem* ps, mat4 view, mat4 projection) {
-    glUseProgram(ps->renderProgram);
-    glUniformMatrix4fv(glGetUniformLocation(ps->renderProgram, "view"), 1, GL_FALSE, (float*)view);
-    glUniformMatrix4fv(glGetUniformLocation(ps->renderProgram, "projection"), 1, GL_FALSE, (float*)projection);
+    bool fused = fused_active(ps);
+    // The plain draw takes its palette from an attribute, marks are its only storage block
+    bool flags = ps->flagsInUse && ps->vertexStorageBlocks >= 1;
+    unsigned int program = fused || flags ? render_program(ps, fused, flags) : ps->renderProgram;
+    if (!program) {
+        // The update skipped its compute pass, don't leave particles unstepped again
+        if (fused) {
+            fprintf(stderr, "Fused render variant unavailable, using the compute pass\n");
+            ps->fusedSupported = false;
+        }
+        fused = false;
+        flags = false;
+        program = ps->renderProgram;
+    }
+    ps->fusedDrawn = fused;
 
-    glBindVertexArray(ps->particleVAO);
-    glDrawArrays(GL_POINTS, 0, ps->numParticles);
+    glUseProgram(program);
+    glUniformMatrix4fv(glGetUniformLocation(program, "view"), 1, GL_FALSE, (float*)view);
+    glUniformMatrix4fv(glGetUniformLocation(program, "projection"), 1, GL_FALSE, (float*)projection);
+    colormap_bind(&ps->colormap, program, 0);
+    if (fused) {
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, ps->groupTableBuffer);
+        glUniform1f(glGetUniformLocation(program, "delta_time"), ps->deltaTime);
+        glUniform2fv(glGetUniformLocation(program, "mouse_pos"), 1, ps->mousePos);
+        glUniform1f(glGetUniformLocation(program, "force_radius"), ps->forceRadius);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, ps->positionBuffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, ps->velocityBuffer);
+    }
+    if (flags) {
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, PARTICLE_FLAGS_BINDING, ps->flagBuffer);
+    }
+
+    // All runs in one multi-draw over their active ranges, one command per table entry
+    int slot = ps->queryFrame % PARTICLE_TIMER_FRAMES;
+    glBindVertexArray(fused ? ps->pullVAO : ps->particleVAO);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, ps->drawCommandBuffer);
+    glBeginQuery(GL_TIME_ELAPSED, ps->drawQueries[slot]);
+    glMultiDrawArraysIndirect(GL_POINTS, (void*)0, ps->tableCount, 0);
+    glEndQuery(GL_TIME_ELAPSED);
+
+    // The next frame's draw, an export copy or a switch back to the compute
+    // path reads what this draw wrote
+    if (fused) {
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT |
+                        GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+    }
+
+    ps->queryFrame++;
 }
 
 void particle_system_cleanup(ParticleSystem* ps) {
     glDeleteVertexArrays(1, &ps->particleVAO);
+    glDeleteVertexArrays(1, &ps->pullVAO);
     glDeleteBuffers(1, &ps->positionBuffer);
     glDeleteBuffers(1, &ps->velocityBuffer);
     glDeleteBuffers(1, &ps->velocityMagBuffer);
-    glDeleteProgram(ps->computeProgram);
-    glDeleteProgram(ps->renderProgram);
+    glDeleteBuffers(1, &ps->groupTableBuffer);
+    glDeleteBuffers(1, &ps->drawCommandBuffer);
+    glDeleteBuffers(1, &ps->drawInstanceBuffer);
+    if (ps->speciesBuffer) {
+        glDeleteBuffers(1, &ps->speciesBuffer);
+    }
+    if (ps->flagBuffer) {
+        glDeleteBuffers(1, &ps->flagBuffer);
+    }
+    shader_variant_cache_cleanup(&ps->computeVariants);
+    shader_variant_cache_cleanup(&ps->renderVariants);
+    glDeleteQueries(PARTICLE_TIMER_FRAMES, ps->stepQueries);
+    glDeleteQueries(PARTICLE_TIMER_FRAMES, ps->drawQueries);
+    particle_stats_cleanup(&ps->stats);
+    particle_activity_cleanup(&ps->activity);
+    colormap_cleanup(&ps->colormap);
+    destroy_streamer(ps->streamer);
+    ps->streamer = NULL;
 }
 
 void particle_system_set_mouse_pos(ParticleSystem* ps, float x, float y) {
     ps->mousePos[0] = x;
     ps->mousePos[1] = y;
-}
\ No newline at end of file
+}
+
+int particle_system_set_active_count(ParticleSystem* ps, int count) {
+    // Buffers stay allocated at full capacity, only the dispatched ranges change.
+    // Every group is scaled by the same fraction of its capacity.
+    int capacity = particle_system_group_capacity(ps);
+    if (count < 0) count = 0;
+    if (count > capacity) count = capacity;
+
+    double fraction = capacity > 0 ? (double)count / capacity : 0.0;
+    for (int i = 0; i < ps->groupCount; i++) {
+        ParticleGroup* group = &ps->groups[i];
+        group->count = (int)(group->capacity * fraction);
+    }
+    refresh_active_count(ps);
+    return ps->count;
+}
+
+int particle_system_group_capacity(ParticleSystem* ps) {
+    int capacity = 0;
+    for (int i = 0; i < ps->groupCount; i++) {
+        capacity += ps->groups[i].capacity;
+    }
+    return capacity;
+}
+
+static int align_up(int value, int alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+// First-fit search for a free range between the sorted groups
+static int find_free_range(ParticleSystem* ps, int capacity, int* insertAt) {
+    int cursor = 0;
+    for (int i = 0; i <= ps->groupCount; i++) {
+        int end = i < ps->groupCount ? ps->groups[i].offset : ps->numParticles;
+        if (end - cursor >= capacity) {
+            *insertAt = i;
+            return cursor;
+        }
+        if (i < ps->groupCount) {
+            cursor = align_up(ps->groups[i].offset + ps->groups[i].capacity, PARTICLE_GROUP_ALIGNMENT);
+        }
+    }
+    return -1;
+}
+
+static void generate_chunk_job(void* data) {
+    StreamChunk* chunk = (StreamChunk*)data;
+    const SimdKernels* simd = simd_get();
+    for (int first = 0; first < chunk->count; first += PARTICLE_GEN_CHUNK) {
+        int count = chunk->count - first < PARTICLE_GEN_CHUNK ? chunk->count - first : PARTICLE_GEN_CHUNK;
+        uint32_t seedIndex = (uint32_t)((chunk->first + first) / PARTICLE_GEN_CHUNK);
+        simd->init_positions(chunk->positions + first, count, chunk->desc.center, chunk->desc.extent,
+                             chunk->desc.seed ^ (seedIndex * 0x9E3779B9u));
+        simd->zero_velocities(chunk->velocities + first, count);
+    }
+}
+
+// Continuation of generate_chunk_job, reduces the chunk on the workers
+// instead of on the main thread at upload
+static void seed_stats_job(void* data) {
+    StreamChunk* chunk = (StreamChunk*)data;
+    particle_stats_reduce_cpu(chunk->positions, chunk->velocities, chunk->count, &chunk->stats);
+}
+
+// Hand the next chunks of unfinished groups to the job system while slots are free
+static void stream_schedule(ParticleSystem* ps) {
+    ParticleStreamer* streamer = ps->streamer;
+    if (!streamer) {
+        return;
+    }
+
+    int groupIndex = 0;
+    while (streamer->scheduled - streamer->uploaded < PARTICLE_STREAM_SLOTS) {
+        while (groupIndex < ps->groupCount &&
+               ps->groups[groupIndex].scheduled >= ps->groups[groupIndex].capacity) {
+            groupIndex++;
+        }
+        if (groupIndex == ps->groupCount) {
+            return;
+        }
+
+        ParticleGroup* group = &ps->groups[groupIndex];
+        StreamChunk* chunk = &streamer->chunks[streamer->scheduled % PARTICLE_STREAM_SLOTS];
+        int remaining = group->capacity - group->scheduled;
+        chunk->groupId = group->id;
+        chunk->first = group->scheduled;
+        chunk->count = remaining < PARTICLE_STREAM_CHUNK ? remaining : PARTICLE_STREAM_CHUNK;
+        chunk->desc = group->desc;
+        group->scheduled += chunk->count;
+
+        // Stats come from host data until the first GPU readback lands
+        chunk->seedStats = ps->count == 0;
+        if (chunk->seedStats) {
+            job_submit(&chunk->generated, generate_chunk_job, chunk);
+            job_submit_after(&chunk->generated, &chunk->done, seed_stats_job, chunk);
+        } else {
+            job_submit(&chunk->done, generate_chunk_job, chunk);
+        }
+        streamer->scheduled++;
+    }
+}
+
+// Species ids of a freshly uploaded range of a group, run by run
+static void upload_species(ParticleSystem* ps, const ParticleGroup* group, int first, int count) {
+    if (!ps->speciesBuffer) {
+        return;
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, ps->speciesBuffer);
+    for (int r = 0; r < group->runCount; r++) {
+        const SpeciesRun* run = &group->runs[r];
+        int begin = first > run->offset ? first : run->offset;
+        int end = first + count < run->offset + run->capacity ? first + count : run->offset + run->capacity;
+        if (begin < end) {
+            unsigned char id = (unsigned char)run->species;
+            glClearBufferSubData(GL_SHADER_STORAGE_BUFFER, GL_R8UI, group->offset + begin, end - begin,
+                                 GL_RED_INTEGER, GL_UNSIGNED_BYTE, &id);
+        }
+    }
+}
+
+void particle_system_enable_species(ParticleSystem* ps) {
+    if (ps->speciesBuffer) {
+        return;
+    }
+
+    // Species 0 everywhere, then every group's runs over their whole range
+    unsigned int zero = 0;
+    glGenBuffers(1, &ps->speciesBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, ps->speciesBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, ((GLsizeiptr)ps->numParticles + 3) / 4 * 4, NULL, GL_DYNAMIC_DRAW);
+    glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+    for (int i = 0; i < ps->groupCount; i++) {
+        upload_species(ps, &ps->groups[i], 0, ps->groups[i].capacity);
+    }
+}
+
+static ParticleGroup* find_group(ParticleSystem* ps, int id) {
+    for (int i = 0; i < ps->groupCount; i++) {
+        if (ps->groups[i].id == id) {
+            return &ps->groups[i];
+        }
+    }
+    return NULL;
+}
+
+void particle_system_stream(ParticleSystem* ps) {
+    ParticleStreamer* streamer = ps->streamer;
+    if (!streamer) {
+        return;
+    }
+
+    // Bounded per frame so loading never causes a long hitch
+    int uploads = 0;
+    while (streamer->uploaded != streamer->scheduled && uploads < PARTICLE_STREAM_UPLOADS_PER_FRAME) {
+        StreamChunk* chunk = &streamer->chunks[streamer->uploaded % PARTICLE_STREAM_SLOTS];
+        if (!job_done(&chunk->done)) {
+            break;
+        }
+
+        // Chunks of removed groups are dropped, ids are never reused
+        ParticleGroup* group = find_group(ps, chunk->groupId);
+        if (group) {
+            GLintptr offset = (GLintptr)(group->offset + chunk->first) * sizeof(vec2);
+            GLsizeiptr size = (GLsizeiptr)chunk->count * sizeof(vec2);
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, ps->positionBuffer);
+            glBufferSubData(GL_SHADER_STORAGE_BUFFER, offset, size, chunk->positions);
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, ps->velocityBuffer);
+            glBufferSubData(GL_SHADER_STORAGE_BUFFER, offset, size, chunk->velocities);
+            if (ps->flagBuffer) {
+                // Fresh particles carry no marks from whatever used this range before
+                unsigned char zero = 0;
+                glBindBuffer(GL_SHADER_STORAGE_BUFFER, ps->flagBuffer);
+                glClearBufferSubData(GL_SHADER_STORAGE_BUFFER, GL_R8UI, group->offset + chunk->first,
+                                     chunk->count, GL_RED_INTEGER, GL_UNSIGNED_BYTE, &zero);
+            }
+            upload_species(ps, group, chunk->first, chunk->count);
+            group->loaded += chunk->count;
+
+            // Seed stats from host data until the first GPU readback lands
+            if (ps->count == 0 && chunk->seedStats) {
+                ps->stats.latest = chunk->stats;
+            }
+            refresh_active_count(ps);
+            uploads++;
+        }
+        streamer->uploaded++;
+    }
+
+    stream_schedule(ps);
+}
+
+float particle_system_load_progress(ParticleSystem* ps) {
+    long long loaded = 0;
+    long long capacity = 0;
+    for (int i = 0; i < ps->groupCount; i++) {
+        loaded += ps->groups[i].loaded;
+        capacity += ps->groups[i].capacity;
+    }
+    return capacity > 0 ? (float)((double)loaded / capacity) : 1.0f;
+}
+
+// Split the group range into one run per species in the mix. Runs start on
+// the group alignment, so tiles and particle pairs never cross a run.
+static void layout_species_runs(ParticleSystem* ps, ParticleGroup* group) {
+    int requested[PARTICLE_MAX_SPECIES];
+    int requestedCount = 0;
+    for (int s = 0; s < ps->speciesCount; s++) {
+        if (group->desc.speciesMix[s] > 0.0f) {
+            requested[requestedCount++] = s;
+        }
+    }
+
+    group->runCount = 0;
+    if (requestedCount == 0) {
+        group->runs[0].species = 0;
+        group->runs[0].offset = 0;
+        group->runs[0].capacity = group->capacity;
+        group->runCount = 1;
+        return;
+    }
+
+    // Runs start on aligned blocks, a species without a block of its own is dropped
+    int blocks = group->capacity / PARTICLE_GROUP_ALIGNMENT;
+    int kept = requestedCount < blocks ? requestedCount : blocks > 1 ? blocks : 1;
+    for (int i = kept; i < requestedCount; i++) {
+        fprintf(stderr, "Species %s dropped from a group of %d particles, each species needs %d\n",
+                ps->species[requested[i]].name, group->capacity, PARTICLE_GROUP_ALIGNMENT);
+    }
+
+    float total = 0.0f;
+    for (int i = 0; i < kept; i++) {
+        total += group->desc.speciesMix[requested[i]];
+    }
+
+    int offset = 0;
+    float placed = 0.0f;
+    for (int i = 0; i < kept; i++) {
+        int s = requested[i];
+        // The last species takes the remainder, the others end on a block
+        // boundary with at least one block each and one left for every
+        // species after them
+        int end = group->capacity;
+        if (i != kept - 1) {
+            placed += group->desc.speciesMix[s];
+            int block = (int)(blocks * (double)(placed / total));
+            int minBlock = offset / PARTICLE_GROUP_ALIGNMENT + 1;
+            int maxBlock = blocks - (kept - 1 - i);
+            block = block < minBlock ? minBlock : block > maxBlock ? maxBlock : block;
+            end = block * PARTICLE_GROUP_ALIGNMENT;
+        }
+        SpeciesRun* run = &group->runs[group->runCount++];
+        run->species = s;
+        run->offset = offset;
+        run->capacity = end - offset;
+        offset = end;
+    }
+}
+
+int particle_system_add_group(ParticleSystem* ps, const ParticleGroupDesc* desc) {
+    if (ps->groupCount >= MAX_PARTICLE_GROUPS || desc->capacity <= 0) {
+        return -1;
+    }
+
+    int insertAt = 0;
+    int offset = find_free_range(ps, desc->capacity, &insertAt);
+    if (offset < 0) {
+        fprintf(stderr, "No room in particle pool for %d particles\n", desc->capacity);
+        return -1;
+    }
+
+    for (int i = ps->groupCount; i > insertAt; i--) {
+        ps->groups[i] = ps->groups[i - 1];
+    }
+
+    ParticleGroup* group = &ps->groups[insertAt];
+    group->id = ps->nextGroupId++;
+    group->offset = offset;
+    group->capacity = desc->capacity;
+    group->count = desc->capacity;
+    group->scheduled = 0;
+    group->loaded = 0;
+    group->desc = *desc;
+    layout_species_runs(ps, group);
+    ps->groupCount++;
+    if (group->runCount > 1 || group->runs[0].species != 0) {
+        particle_system_enable_species(ps);
+    }
+
+    // Generation starts right away, the particles show up as chunks are streamed in
+    int id = group->id;
+    stream_schedule(ps);
+    return id;
+}
+
+void particle_system_remove_group(ParticleSystem* ps, int id) {
+    for (int i = 0; i < ps->groupCount; i++) {
+        if (ps->groups[i].id == id) {
+            for (int j = i; j < ps->groupCount - 1; j++) {
+                ps->groups[j] = ps->groups[j + 1];
+            }
+            ps->groupCount--;
+            refresh_active_count(ps);
+            return;
+        }
+    }
+}
+
+void particle_system_clear_groups(ParticleSystem* ps) {
+    ps->groupCount = 0;
+    ps->count = 0;
+}
+
+void particle_system_set_palette(ParticleSystem* ps, int palette) {
+    colormap_set_palette(&ps->colormap, palette);
+    for (int i = 0; i < ps->groupCount; i++) {
+        ps->groups[i].desc.palette = ps->colormap.palette;
+    }
+}
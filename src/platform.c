@@ -0,0 +1,548 @@
+// CPU affinity (sched_setaffinity, CPU_SET) is a GNU extension
+#if !defined(_WIN32) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+#include "platform.h"
+#include <stdlib.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <stdio.h>
+#include <string.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+#define PLATFORM_DEFAULT_HUGE_PAGE (2u * 1024u * 1024u)
+
+typedef struct {
+    PlatformThreadFunc func;
+    void* arg;
+} ThreadStart;
+
+double platform_time_seconds(void) {
+#ifdef _WIN32
+    static LARGE_INTEGER frequency;
+    if (frequency.QuadPart == 0) {
+        QueryPerformanceFrequency(&frequency);
+    }
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    return (double)counter.QuadPart / (double)frequency.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+#endif
+}
+
+int platform_cpu_count(void) {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    int count = (int)info.dwNumberOfProcessors;
+#else
+    int count = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    return count > 0 ? count : 1;
+}
+
+void platform_yield(void) {
+#ifdef _WIN32
+    SwitchToThread();
+#else
+    sched_yield();
+#endif
+}
+
+void platform_sleep_ms(int milliseconds) {
+#ifdef _WIN32
+    Sleep(milliseconds);
+#else
+    struct timespec ts = { milliseconds / 1000, (milliseconds % 1000) * 1000000L };
+    nanosleep(&ts, NULL);
+#endif
+}
+
+#ifdef _WIN32
+static DWORD WINAPI thread_start(LPVOID arg) {
+    ThreadStart start = *(ThreadStart*)arg;
+    free(arg);
+    start.func(start.arg);
+    return 0;
+}
+#else
+static void* thread_start(void* arg) {
+    ThreadStart start = *(ThreadStart*)arg;
+    free(arg);
+    start.func(start.arg);
+    return NULL;
+}
+#endif
+
+bool platform_thread_create(PlatformThread* thread, PlatformThreadFunc func, void* arg) {
+    ThreadStart* start = (ThreadStart*)malloc(sizeof(ThreadStart));
+    if (!start) {
+        return false;
+    }
+    start->func = func;
+    start->arg = arg;
+
+#ifdef _WIN32
+    thread->handle = CreateThread(NULL, 0, thread_start, start, 0, NULL);
+    if (!thread->handle) {
+        free(start);
+        return false;
+    }
+#else
+    if (pthread_create(&thread->handle, NULL, thread_start, start) != 0) {
+        free(start);
+        return false;
+    }
+#endif
+    return true;
+}
+
+void platform_thread_join(PlatformThread* thread) {
+#ifdef _WIN32
+    WaitForSingleObject((HANDLE)thread->handle, INFINITE);
+    CloseHandle((HANDLE)thread->handle);
+#else
+    pthread_join(thread->handle, NULL);
+#endif
+}
+
+void platform_mutex_init(PlatformMutex* mutex) {
+#ifdef _WIN32
+    InitializeSRWLock((PSRWLOCK)&mutex->lock);
+#else
+    pthread_mutex_init(&mutex->lock, NULL);
+#endif
+}
+
+void platform_mutex_lock(PlatformMutex* mutex) {
+#ifdef _WIN32
+    AcquireSRWLockExclusive((PSRWLOCK)&mutex->lock);
+#else
+    pthread_mutex_lock(&mutex->lock);
+#endif
+}
+
+void platform_mutex_unlock(PlatformMutex* mutex) {
+#ifdef _WIN32
+    ReleaseSRWLockExclusive((PSRWLOCK)&mutex->lock);
+#else
+    pthread_mutex_unlock(&mutex->lock);
+#endif
+}
+
+void platform_mutex_destroy(PlatformMutex* mutex) {
+#ifndef _WIN32
+    pthread_mutex_destroy(&mutex->lock);
+#else
+    (void)mutex;
+#endif
+}
+
+void platform_cond_init(PlatformCond* cond) {
+#ifdef _WIN32
+    InitializeConditionVariable((PCONDITION_VARIABLE)&cond->cond);
+#else
+    pthread_cond_init(&cond->cond, NULL);
+#endif
+}
+
+void platform_cond_wait(PlatformCond* cond, PlatformMutex* mutex) {
+#ifdef _WIN32
+    SleepConditionVariableSRW((PCONDITION_VARIABLE)&cond->cond, (PSRWLOCK)&mutex->lock, INFINITE, 0);
+#else
+    pthread_cond_wait(&cond->cond, &mutex->lock);
+#endif
+}
+
+bool platform_cond_timed_wait(PlatformCond* cond, PlatformMutex* mutex, int milliseconds) {
+#ifdef _WIN32
+    return SleepConditionVariableSRW((PCONDITION_VARIABLE)&cond->cond, (PSRWLOCK)&mutex->lock,
+                                     (DWORD)milliseconds, 0) != 0;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec += milliseconds / 1000;
+    ts.tv_nsec += (milliseconds % 1000) * 1000000L;
+    if (ts.tv_nsec >= 1000000000L) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000L;
+    }
+    return pthread_cond_timedwait(&cond->cond, &mutex->lock, &ts) != ETIMEDOUT;
+#endif
+}
+
+void platform_cond_signal(PlatformCond* cond) {
+#ifdef _WIN32
+    WakeConditionVariable((PCONDITION_VARIABLE)&cond->cond);
+#else
+    pthread_cond_signal(&cond->cond);
+#endif
+}
+
+void platform_cond_broadcast(PlatformCond* cond) {
+#ifdef _WIN32
+    WakeAllConditionVariable((PCONDITION_VARIABLE)&cond->cond);
+#else
+    pthread_cond_broadcast(&cond->cond);
+#endif
+}
+
+void platform_cond_destroy(PlatformCond* cond) {
+#ifndef _WIN32
+    pthread_cond_destroy(&cond->cond);
+#else
+    (void)cond;
+#endif
+}
+
+size_t platform_page_size(void) {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwPageSize;
+#else
+    long size = sysconf(_SC_PAGESIZE);
+    return size > 0 ? (size_t)size : 4096;
+#endif
+}
+
+size_t platform_huge_page_size(void) {
+    static size_t hugePageSize = 0;
+    if (hugePageSize) {
+        return hugePageSize;
+    }
+
+    hugePageSize = PLATFORM_DEFAULT_HUGE_PAGE;
+#ifdef _WIN32
+    SIZE_T minimum = GetLargePageMinimum();
+    if (minimum) {
+        hugePageSize = minimum;
+    }
+#else
+    FILE* meminfo = fopen("/proc/meminfo", "r");
+    if (meminfo) {
+        char line[128];
+        unsigned long kb;
+        while (fgets(line, sizeof(line), meminfo)) {
+            if (sscanf(line, "Hugepagesize: %lu kB", &kb) == 1 && kb > 0) {
+                hugePageSize = (size_t)kb * 1024;
+                break;
+            }
+        }
+        fclose(meminfo);
+    }
+#endif
+    return hugePageSize;
+}
+
+#ifdef _WIN32
+// Large pages need SeLockMemoryPrivilege enabled on the process token
+static bool enable_lock_memory_privilege(void) {
+    HANDLE token;
+    if (!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token)) {
+        return false;
+    }
+
+    TOKEN_PRIVILEGES privileges;
+    privileges.PrivilegeCount = 1;
+    privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+    bool enabled = LookupPrivilegeValueA(NULL, "SeLockMemoryPrivilege", &privileges.Privileges[0].Luid) &&
+                   AdjustTokenPrivileges(token, FALSE, &privileges, 0, NULL, NULL) &&
+                   GetLastError() == ERROR_SUCCESS;
+    CloseHandle(token);
+    return enabled;
+}
+#endif
+
+void* platform_alloc_pages(size_t size, bool preferHuge, PlatformPageKind* kind) {
+    *kind = PLATFORM_PAGES_NORMAL;
+#ifdef _WIN32
+    if (preferHuge && GetLargePageMinimum() && enable_lock_memory_privilege()) {
+        void* memory = VirtualAlloc(NULL, size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+        if (memory) {
+            *kind = PLATFORM_PAGES_HUGE;
+            return memory;
+        }
+    }
+    return VirtualAlloc(NULL, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#else
+#ifdef MAP_HUGETLB
+    if (preferHuge) {
+        // Explicit huge pages only exist if the admin reserved some
+        void* memory = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (memory != MAP_FAILED) {
+            *kind = PLATFORM_PAGES_HUGE;
+            return memory;
+        }
+    }
+#endif
+
+    // Over-map so the block can start on a huge page boundary, THP only
+    // backs aligned 2 MB extents
+    size_t alignment = preferHuge ? platform_huge_page_size() : platform_page_size();
+    size_t mapped = size + alignment;
+    unsigned char* raw = (unsigned char*)mmap(NULL, mapped, PROT_READ | PROT_WRITE,
+                                              MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED) {
+        return NULL;
+    }
+
+    unsigned char* aligned = (unsigned char*)(((uintptr_t)raw + alignment - 1) & ~(uintptr_t)(alignment - 1));
+    if (aligned > raw) {
+        munmap(raw, aligned - raw);
+    }
+    size_t tail = (raw + mapped) - (aligned + size);
+    if (tail > 0) {
+        munmap(aligned + size, tail);
+    }
+
+#ifdef MADV_HUGEPAGE
+    if (preferHuge && madvise(aligned, size, MADV_HUGEPAGE) == 0) {
+        *kind = PLATFORM_PAGES_TRANSPARENT_HUGE;
+    }
+#endif
+    return aligned;
+#endif
+}
+
+void platform_free_pages(void* memory, size_t size) {
+    if (!memory) {
+        return;
+    }
+#ifdef _WIN32
+    (void)size;
+    VirtualFree(memory, 0, MEM_RELEASE);
+#else
+    munmap(memory, size);
+#endif
+}
+
+#ifndef _WIN32
+// Parse a sysfs cpulist such as "0-7,16-23"
+static int parse_cpu_list(const char* list, int* cpus, int maxCpus) {
+    int count = 0;
+    const char* p = list;
+    while (*p && *p != '\n') {
+        char* end;
+        long first = strtol(p, &end, 10);
+        if (end == p) {
+            break;
+        }
+        long last = first;
+        if (*end == '-') {
+            p = end + 1;
+            last = strtol(p, &end, 10);
+        }
+        for (long cpu = first; cpu <= last && count < maxCpus; cpu++) {
+            cpus[count++] = (int)cpu;
+        }
+        p = *end == ',' ? end + 1 : end;
+    }
+    return count;
+}
+#endif
+
+int platform_numa_node_count(void) {
+    int count = 1;
+#ifdef _WIN32
+    ULONG highest = 0;
+    if (GetNumaHighestNodeNumber(&highest)) {
+        count = (int)highest + 1;
+    }
+#else
+    for (int node = 1; node < PLATFORM_MAX_NUMA_NODES; node++) {
+        char path[64];
+        struct stat info;
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d", node);
+        if (stat(path, &info) != 0) {
+            break;
+        }
+        count = node + 1;
+    }
+#endif
+    return count < PLATFORM_MAX_NUMA_NODES ? count : PLATFORM_MAX_NUMA_NODES;
+}
+
+int platform_numa_node_cpus(int node, int* cpus, int maxCpus) {
+    int count = 0;
+#ifdef _WIN32
+    GROUP_AFFINITY affinity;
+    if (GetNumaNodeProcessorMaskEx((USHORT)node, &affinity)) {
+        for (int bit = 0; bit < 64 && count < maxCpus; bit++) {
+            if (affinity.Mask & ((KAFFINITY)1 << bit)) {
+                cpus[count++] = affinity.Group * 64 + bit;
+            }
+        }
+    }
+#else
+    char path[64];
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+    FILE* file = fopen(path, "r");
+    if (file) {
+        char list[1024];
+        if (fgets(list, sizeof(list), file)) {
+            count = parse_cpu_list(list, cpus, maxCpus);
+        }
+        fclose(file);
+    }
+#endif
+    // No topology information, node 0 is the whole machine
+    if (count == 0 && node == 0) {
+        int total = platform_cpu_count();
+        for (int cpu = 0; cpu < total && count < maxCpus; cpu++) {
+            cpus[count++] = cpu;
+        }
+    }
+    return count;
+}
+
+bool platform_thread_pin(int cpu) {
+#ifdef _WIN32
+    GROUP_AFFINITY affinity;
+    memset(&affinity, 0, sizeof(affinity));
+    affinity.Group = (WORD)(cpu / 64);
+    affinity.Mask = (KAFFINITY)1 << (cpu % 64);
+    return SetThreadGroupAffinity(GetCurrentThread(), &affinity, NULL) != 0;
+#else
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return sched_setaffinity(0, sizeof(set), &set) == 0;
+#endif
+}
+
+bool platform_make_directory(const char* path) {
+#ifdef _WIN32
+    if (CreateDirectoryA(path, NULL)) {
+        return true;
+    }
+    DWORD attributes = GetFileAttributesA(path);
+    return attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_DIRECTORY);
+#else
+    if (mkdir(path, 0755) == 0) {
+        return true;
+    }
+    struct stat info;
+    return errno == EEXIST && stat(path, &info) == 0 && S_ISDIR(info.st_mode);
+#endif
+}
+
+#ifdef _WIN32
+// Win32 mapping names can't contain backslashes but '/' is fine, drop the leading one
+static const char* mapping_name(const char* name) {
+    return name[0] == '/' ? name + 1 : name;
+}
+#endif
+
+bool platform_shared_memory_create(PlatformSharedMemory* shm, const char* name, size_t size) {
+    memset(shm, 0, sizeof(*shm));
+    snprintf(shm->name, sizeof(shm->name), "%s", name);
+    shm->size = size;
+#ifdef _WIN32
+    shm->handle = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE,
+                                     (DWORD)((unsigned long long)size >> 32), (DWORD)(size & 0xFFFFFFFFu),
+                                     mapping_name(name));
+    if (!shm->handle) {
+        return false;
+    }
+    shm->memory = MapViewOfFile(shm->handle, FILE_MAP_ALL_ACCESS, 0, 0, size);
+    if (!shm->memory) {
+        CloseHandle(shm->handle);
+        shm->handle = NULL;
+        return false;
+    }
+#else
+    shm->fd = shm_open(name, O_CREAT | O_RDWR, 0600);
+    if (shm->fd < 0) {
+        return false;
+    }
+    if (ftruncate(shm->fd, (off_t)size) != 0) {
+        close(shm->fd);
+        shm_unlink(name);
+        return false;
+    }
+    shm->memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, shm->fd, 0);
+    if (shm->memory == MAP_FAILED) {
+        shm->memory = NULL;
+        close(shm->fd);
+        shm_unlink(name);
+        return false;
+    }
+#endif
+    return true;
+}
+
+bool platform_shared_memory_open(PlatformSharedMemory* shm, const char* name) {
+    memset(shm, 0, sizeof(*shm));
+    snprintf(shm->name, sizeof(shm->name), "%s", name);
+#ifdef _WIN32
+    shm->handle = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, mapping_name(name));
+    if (!shm->handle) {
+        return false;
+    }
+    shm->memory = MapViewOfFile(shm->handle, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+    if (!shm->memory) {
+        CloseHandle(shm->handle);
+        shm->handle = NULL;
+        return false;
+    }
+    MEMORY_BASIC_INFORMATION info;
+    VirtualQuery(shm->memory, &info, sizeof(info));
+    shm->size = info.RegionSize;
+#else
+    shm->fd = shm_open(name, O_RDWR, 0600);
+    if (shm->fd < 0) {
+        return false;
+    }
+    struct stat info;
+    if (fstat(shm->fd, &info) != 0 || info.st_size <= 0) {
+        close(shm->fd);
+        return false;
+    }
+    shm->size = (size_t)info.st_size;
+    shm->memory = mmap(NULL, shm->size, PROT_READ | PROT_WRITE, MAP_SHARED, shm->fd, 0);
+    if (shm->memory == MAP_FAILED) {
+        shm->memory = NULL;
+        close(shm->fd);
+        return false;
+    }
+#endif
+    return true;
+}
+
+void platform_shared_memory_close(PlatformSharedMemory* shm, bool remove) {
+    if (!shm->memory) {
+        return;
+    }
+#ifdef _WIN32
+    // The mapping disappears once the last handle is closed
+    (void)remove;
+    UnmapViewOfFile(shm->memory);
+    CloseHandle(shm->handle);
+    shm->handle = NULL;
+#else
+    munmap(shm->memory, shm->size);
+    close(shm->fd);
+    if (remove) {
+        shm_unlink(shm->name);
+    }
+#endif
+    shm->memory = NULL;
+}
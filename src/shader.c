@@ -1,6 +1,8 @@
 #include "shader.h"
+#include "job_system.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 char* read_shader_file(const char* filename) {
     FILE* file;
@@ -41,6 +43,37 @@ char* read_shader_file(const char* filename) {
     return content;
 }
 
+typedef struct {
+    const char* filename;
+    char* source;
+} ReadJob;
+
+static void read_job(void* data) {
+    ReadJob* job = (ReadJob*)data;
+    job->source = read_shader_file(job->filename);
+}
+
+void read_shader_files(const char* const* filenames, char** sources, int count) {
+    ReadJob reads[SHADER_MAX_STAGES * 2];
+    JobCounter counter;
+    memset(&counter, 0, sizeof(counter));
+
+    int queued = count < (int)(sizeof(reads) / sizeof(reads[0])) ? count : (int)(sizeof(reads) / sizeof(reads[0]));
+    for (int i = 0; i < queued; i++) {
+        reads[i].filename = filenames[i];
+        reads[i].source = NULL;
+        job_submit(&counter, read_job, &reads[i]);
+    }
+    for (int i = queued; i < count; i++) {
+        sources[i] = read_shader_file(filenames[i]);
+    }
+    job_wait(&counter);
+
+    for (int i = 0; i < queued; i++) {
+        sources[i] = reads[i].source;
+    }
+}
+
 unsigned int compile_shader(const char* source, GLenum type) {
     unsigned int shader = glCreateShader(type);
     glShaderSource(shader, 1, &source, NULL);
@@ -65,4 +98,175 @@ void check_program_linking(unsigned int program, const char* type) {
         glGetProgramInfoLog(program, 512, NULL, infoLog);
         fprintf(stderr, "Program linking failed:\n%s\n", infoLog);
     }
-} 
\ No newline at end of file
+} 
+
+char* inject_shader_defines(const char* source, const ShaderDefine* defines, int defineCount) {
+    // Defines must follow #version, which has to stay the first statement
+    const char* versionLine = strstr(source, "#version");
+    const char* insertAt = source;
+    int lineNumber = 1;
+    if (versionLine) {
+        const char* newline = strchr(versionLine, '\n');
+        insertAt = newline ? newline + 1 : versionLine + strlen(versionLine);
+        for (const char* c = source; c < insertAt; c++) {
+            if (*c == '\n') lineNumber++;
+        }
+    }
+
+    size_t prefixLength = insertAt - source;
+    size_t length = strlen(source) + 32;
+    for (int i = 0; i < defineCount; i++) {
+        length += strlen(defines[i].name) + strlen(defines[i].value) + 10;
+    }
+
+    char* result = (char*)malloc(length);
+    if (!result) {
+        return NULL;
+    }
+
+    memcpy(result, source, prefixLength);
+    size_t write = prefixLength;
+    if (write > 0 && result[write - 1] != '\n') {
+        result[write++] = '\n';
+    }
+    for (int i = 0; i < defineCount; i++) {
+        write += sprintf(result + write, "#define %s %s\n", defines[i].name, defines[i].value);
+    }
+    // Keep compiler error line numbers matching the file on disk
+    write += sprintf(result + write, "#line %d\n", lineNumber);
+    strcpy(result + write, insertAt);
+    return result;
+}
+
+int shader_variant_cache_init(ShaderVariantCache* cache, const char* label,
+                              const char* const* filenames, const GLenum* types, int stageCount) {
+    memset(cache, 0, sizeof(*cache));
+    cache->label = label;
+    if (stageCount > SHADER_MAX_STAGES) {
+        fprintf(stderr, "Too many shader stages for %s\n", label);
+        return 0;
+    }
+
+    read_shader_files(filenames, cache->sources, stageCount);
+    for (int i = 0; i < stageCount; i++) {
+        cache->types[i] = types[i];
+        if (!cache->sources[i]) {
+            shader_variant_cache_cleanup(cache);
+            return 0;
+        }
+    }
+    cache->stageCount = stageCount;
+    return 1;
+}
+
+static unsigned int build_variant(ShaderVariantCache* cache, const ShaderDefine* defines, int defineCount) {
+    unsigned int program = glCreateProgram();
+    unsigned int shaders[SHADER_MAX_STAGES];
+
+    for (int i = 0; i < cache->stageCount; i++) {
+        char* source = inject_shader_defines(cache->sources[i], defines, defineCount);
+        shaders[i] = compile_shader(source ? source : cache->sources[i], cache->types[i]);
+        free(source);
+        glAttachShader(program, shaders[i]);
+    }
+
+    glLinkProgram(program);
+    check_program_linking(program, cache->label);
+
+    for (int i = 0; i < cache->stageCount; i++) {
+        glDeleteShader(shaders[i]);
+    }
+
+    int linked = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    if (!linked) {
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
+
+static void variant_key(const ShaderDefine* defines, int defineCount, char* key, uint64_t* hash) {
+    size_t write = 0;
+    key[0] = '\0';
+    for (int i = 0; i < defineCount; i++) {
+        int written = snprintf(key + write, SHADER_VARIANT_KEY_LENGTH - write, "%s=%s;",
+                               defines[i].name, defines[i].value);
+        if (written < 0 || write + written >= SHADER_VARIANT_KEY_LENGTH) {
+            break;
+        }
+        write += written;
+    }
+
+    // FNV-1a, compared before the full key string
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (const char* c = key; *c; c++) {
+        h ^= (unsigned char)*c;
+        h *= 0x100000001b3ULL;
+    }
+    *hash = h;
+}
+
+unsigned int shader_variant_cache_get(ShaderVariantCache* cache, const ShaderDefine* defines, int defineCount) {
+    char key[SHADER_VARIANT_KEY_LENGTH];
+    uint64_t hash;
+    variant_key(defines, defineCount, key, &hash);
+
+    for (int i = 0; i < cache->variantCount; i++) {
+        if (cache->variants[i].hash == hash && strcmp(cache->variants[i].key, key) == 0) {
+            return cache->variants[i].program;
+        }
+    }
+
+    if (cache->stageCount == 0) {
+        return 0;
+    }
+    if (cache->variantCount == cache->variantCapacity) {
+        int capacity = cache->variantCapacity > 0 ? cache->variantCapacity * 2 : SHADER_INITIAL_VARIANTS;
+        ShaderVariant* variants = (ShaderVariant*)realloc(cache->variants, capacity * sizeof(ShaderVariant));
+        if (!variants) {
+            fprintf(stderr, "Failed to grow shader variant cache for %s\n", cache->label);
+            return 0;
+        }
+        cache->variants = variants;
+        cache->variantCapacity = capacity;
+    }
+
+    // Failures are remembered too, so a broken variant is reported once
+    unsigned int program = build_variant(cache, defines, defineCount);
+    ShaderVariant* variant = &cache->variants[cache->variantCount];
+    variant->hash = hash;
+    memcpy(variant->key, key, sizeof(key));
+    variant->program = program;
+    cache->variantCount++;
+    return program;
+}
+
+void shader_variant_cache_release(ShaderVariantCache* cache, unsigned int program) {
+    if (program == 0) {
+        return;
+    }
+    for (int i = 0; i < cache->variantCount; i++) {
+        if (cache->variants[i].program == program) {
+            glDeleteProgram(program);
+            cache->variants[i] = cache->variants[cache->variantCount - 1];
+            cache->variantCount--;
+            return;
+        }
+    }
+}
+
+void shader_variant_cache_cleanup(ShaderVariantCache* cache) {
+    for (int i = 0; i < cache->variantCount; i++) {
+        glDeleteProgram(cache->variants[i].program);
+    }
+    free(cache->variants);
+    cache->variants = NULL;
+    cache->variantCapacity = 0;
+    for (int i = 0; i < SHADER_MAX_STAGES; i++) {
+        free(cache->sources[i]);
+        cache->sources[i] = NULL;
+    }
+    cache->variantCount = 0;
+    cache->stageCount = 0;
+}
@@ -0,0 +1,35 @@
+#include "simd_kernels.h"
+#include <immintrin.h>  // AVX2, built with -mavx2 -mfma
+
+#define SIMD_WIDTH 8
+#define SIMD_ISA SIMD_ISA_AVX2
+#define SIMD_TABLE simd_kernels_avx2
+#define SIMD_FN(name) name##_avx2
+
+typedef __m256 simd_f;
+typedef __m256i simd_i;
+
+#define simd_set1(x)        _mm256_set1_ps(x)
+#define simd_setzero()      _mm256_setzero_ps()
+#define simd_loadu(p)       _mm256_loadu_ps(p)
+#define simd_storeu(p, v)   _mm256_storeu_ps(p, v)
+#define simd_add(a, b)      _mm256_add_ps(a, b)
+#define simd_sub(a, b)      _mm256_sub_ps(a, b)
+#define simd_mul(a, b)      _mm256_mul_ps(a, b)
+#define simd_div(a, b)      _mm256_div_ps(a, b)
+#define simd_min(a, b)      _mm256_min_ps(a, b)
+#define simd_max(a, b)      _mm256_max_ps(a, b)
+#define simd_sqrt(a)        _mm256_sqrt_ps(a)
+#define simd_swap_pairs(v)  _mm256_permute_ps(v, _MM_SHUFFLE(2, 3, 0, 1))
+
+#define simd_i_loadu(p)     _mm256_loadu_si256((const __m256i*)(p))
+#define simd_i_xor(a, b)    _mm256_xor_si256(a, b)
+#define simd_i_add(a, b)    _mm256_add_epi32(a, b)
+#define simd_i_set1(x)      _mm256_set1_epi32(x)
+#define simd_i_slli(v, n)   _mm256_slli_epi32(v, n)
+#define simd_i_srli(v, n)   _mm256_srli_epi32(v, n)
+#define simd_i_to_f(v)      _mm256_cvtepi32_ps(v)
+#define simd_f_to_i(v)      _mm256_cvttps_epi32(v)  // Truncates
+#define simd_i_storeu(p, v) _mm256_storeu_si256((__m256i*)(p), v)
+
+#include "simd_kernels.inl"
@@ -0,0 +1,35 @@
+#include "simd_kernels.h"
+#include <immintrin.h>  // AVX-512F, built with -mavx512f
+
+#define SIMD_WIDTH 16
+#define SIMD_ISA SIMD_ISA_AVX512
+#define SIMD_TABLE simd_kernels_avx512
+#define SIMD_FN(name) name##_avx512
+
+typedef __m512 simd_f;
+typedef __m512i simd_i;
+
+#define simd_set1(x)        _mm512_set1_ps(x)
+#define simd_setzero()      _mm512_setzero_ps()
+#define simd_loadu(p)       _mm512_loadu_ps(p)
+#define simd_storeu(p, v)   _mm512_storeu_ps(p, v)
+#define simd_add(a, b)      _mm512_add_ps(a, b)
+#define simd_sub(a, b)      _mm512_sub_ps(a, b)
+#define simd_mul(a, b)      _mm512_mul_ps(a, b)
+#define simd_div(a, b)      _mm512_div_ps(a, b)
+#define simd_min(a, b)      _mm512_min_ps(a, b)
+#define simd_max(a, b)      _mm512_max_ps(a, b)
+#define simd_sqrt(a)        _mm512_sqrt_ps(a)
+#define simd_swap_pairs(v)  _mm512_permute_ps(v, _MM_SHUFFLE(2, 3, 0, 1))
+
+#define simd_i_loadu(p)     _mm512_loadu_si512((const void*)(p))
+#define simd_i_xor(a, b)    _mm512_xor_si512(a, b)
+#define simd_i_add(a, b)    _mm512_add_epi32(a, b)
+#define simd_i_set1(x)      _mm512_set1_epi32(x)
+#define simd_i_slli(v, n)   _mm512_slli_epi32(v, n)
+#define simd_i_srli(v, n)   _mm512_srli_epi32(v, n)
+#define simd_i_to_f(v)      _mm512_cvtepi32_ps(v)
+#define simd_f_to_i(v)      _mm512_cvttps_epi32(v)  // Truncates
+#define simd_i_storeu(p, v) _mm512_storeu_si512((void*)(p), v)
+
+#include "simd_kernels.inl"
@@ -0,0 +1,112 @@
+#include "simd_kernels.h"
+#include "platform.h"
+#include "arena.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SIMD_BENCH_ITERATIONS 10
+
+static const SimdKernels* selectedKernels = NULL;
+
+static const SimdKernels* const kernelTables[SIMD_ISA_COUNT] = {
+    &simd_kernels_sse2,
+    &simd_kernels_avx2,
+    &simd_kernels_avx512,
+};
+
+const SimdKernels* simd_kernels_for(SimdIsa isa) {
+    if (isa < 0 || isa >= SIMD_ISA_COUNT || !cpu_supports(isa)) {
+        return NULL;
+    }
+    return kernelTables[isa];
+}
+
+void simd_dispatch_init(const char* forcedIsa) {
+    SimdIsa isa = cpu_best_isa();
+
+    if (forcedIsa) {
+        int forced = simd_isa_from_name(forcedIsa);
+        if (forced < 0) {
+            fprintf(stderr, "Unknown SIMD ISA '%s', using %s\n", forcedIsa, simd_isa_name(isa));
+        } else if (!cpu_supports((SimdIsa)forced)) {
+            fprintf(stderr, "CPU does not support %s, using %s\n", forcedIsa, simd_isa_name(isa));
+        } else {
+            isa = (SimdIsa)forced;
+        }
+    }
+
+    selectedKernels = kernelTables[isa];
+    printf("CPU kernels: %s\n", simd_isa_name(isa));
+}
+
+const SimdKernels* simd_get(void) {
+    if (!selectedKernels) {
+        simd_dispatch_init(NULL);
+    }
+    return selectedKernels;
+}
+
+static void print_rate(const char* kernel, int particleCount, int iterations, double seconds) {
+    double rate = seconds > 0.0 ? (double)particleCount * iterations / seconds / 1e6 : 0.0;
+    printf("  %-16s %10.1f Mparticles/s\n", kernel, rate);
+}
+
+void simd_benchmark(int particleCount) {
+    // Prefaulted huge-page arena so page faults don't land in the first ISA
+    Arena arena;
+    size_t bytes = (size_t)particleCount * (2 * sizeof(vec2) + sizeof(float)) + 3 * ARENA_ALIGNMENT;
+    double start = platform_time_seconds();
+    if (!arena_init(&arena, bytes, ARENA_HUGE_PAGES | ARENA_PREFAULT)) {
+        fprintf(stderr, "Failed to allocate benchmark buffers\n");
+        return;
+    }
+    double faultSeconds = platform_time_seconds() - start;
+    vec2* positions = (vec2*)arena_alloc(&arena, particleCount * sizeof(vec2));
+    vec2* velocities = (vec2*)arena_alloc(&arena, particleCount * sizeof(vec2));
+    float* speeds = (float*)arena_alloc(&arena, particleCount * sizeof(float));
+
+    const float center[2] = {0.0f, 0.0f};
+    simd_kernels_sse2.init_positions(positions, particleCount, center, 20.0f, 1);
+
+    SimdIntegrateParams params = { {0.0f, 0.0f}, 2.5f, 0.9998f, 1.0f / 60.0f };
+    printf("SIMD benchmark, %d particles, %d iterations, %s\n", particleCount, SIMD_BENCH_ITERATIONS,
+           arena_page_kind_name(arena.pageKind));
+    printf("  %-16s %10.1f GB/s\n", "first touch", faultSeconds > 0.0 ? arena.capacity / faultSeconds / 1e9 : 0.0);
+
+    for (int isa = 0; isa < SIMD_ISA_COUNT; isa++) {
+        const SimdKernels* k = simd_kernels_for((SimdIsa)isa);
+        if (!k) {
+            printf("%s: not supported\n", simd_isa_name((SimdIsa)isa));
+            continue;
+        }
+        printf("%s:\n", simd_isa_name((SimdIsa)isa));
+
+        start = platform_time_seconds();
+        for (int i = 0; i < SIMD_BENCH_ITERATIONS; i++) {
+            k->init_positions(positions, particleCount, center, 20.0f, (uint32_t)i + 1);
+        }
+        print_rate("init_positions", particleCount, SIMD_BENCH_ITERATIONS, platform_time_seconds() - start);
+
+        start = platform_time_seconds();
+        for (int i = 0; i < SIMD_BENCH_ITERATIONS; i++) {
+            k->zero_velocities(velocities, particleCount);
+        }
+        print_rate("zero_velocities", particleCount, SIMD_BENCH_ITERATIONS, platform_time_seconds() - start);
+
+        start = platform_time_seconds();
+        for (int i = 0; i < SIMD_BENCH_ITERATIONS; i++) {
+            k->integrate(positions, velocities, speeds, particleCount, &params);
+        }
+        print_rate("integrate", particleCount, SIMD_BENCH_ITERATIONS, platform_time_seconds() - start);
+
+        SimdStatsResult result;
+        start = platform_time_seconds();
+        for (int i = 0; i < SIMD_BENCH_ITERATIONS; i++) {
+            k->reduce_stats(positions, velocities, particleCount, &result);
+        }
+        print_rate("reduce_stats", particleCount, SIMD_BENCH_ITERATIONS, platform_time_seconds() - start);
+    }
+
+    arena_release(&arena);
+}
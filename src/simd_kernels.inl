@@ -0,0 +1,390 @@
+// Shared source for the CPU particle kernels. Each simd_<isa>.c defines the
+// SIMD_* vector macros for its instruction set and includes this file.
+//
+// Particles are stored as interleaved (x, y) pairs, so a vector of
+// SIMD_WIDTH floats holds SIMD_WIDTH / 2 particles and simd_swap_pairs()
+// exchanges x and y within each particle.
+
+#include <float.h>
+#include <math.h>
+#include <string.h>
+
+// Floor of the squared mouse distance, also used by the GPU kernels, so a
+// particle exactly at the mouse gets no force instead of a NaN
+#define SIMD_NORMALIZE_EPSILON 1e-12f
+
+// Random bits of float i of a call, a pure function of seed and i so every
+// instruction set and the scalar tail produce the same positions: a Weyl
+// sequence over the float index, scrambled by two xorshift rounds. Vectors
+// advance the sequence with adds only, SSE2 has no 32-bit multiply.
+static inline uint32_t SIMD_FN(scramble)(uint32_t x) {
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return x;
+}
+
+static inline simd_i SIMD_FN(scramble_lanes)(simd_i x) {
+    for (int round = 0; round < 2; round++) {
+        x = simd_i_xor(x, simd_i_slli(x, 13));
+        x = simd_i_xor(x, simd_i_srli(x, 17));
+        x = simd_i_xor(x, simd_i_slli(x, 5));
+    }
+    return x;
+}
+
+// Well mixed start of the Weyl sequence, so neighboring seeds don't overlap
+static inline uint32_t SIMD_FN(seed_base)(uint32_t seed) {
+    uint32_t z = seed + 0x9E3779B9u;
+    z = (z ^ (z >> 16)) * 0x85EBCA6Bu;
+    z = (z ^ (z >> 13)) * 0xC2B2AE35u;
+    return z ^ (z >> 16);
+}
+
+#define SIMD_WEYL_STEP 0x9E3779B9u
+
+static void SIMD_FN(init_positions)(vec2* positions, int count, const float center[2], float extent, uint32_t seed) {
+    float* out = (float*)positions;
+    int floats = count * 2;
+
+    uint32_t base = SIMD_FN(seed_base)(seed);
+    uint32_t lanes[SIMD_WIDTH];
+    float centerLanes[SIMD_WIDTH];
+    for (int l = 0; l < SIMD_WIDTH; l++) {
+        lanes[l] = base + (uint32_t)l * SIMD_WEYL_STEP;
+        centerLanes[l] = center[l & 1];
+    }
+
+    // Signed conversion of the random bits lands in -1..1 after scaling.
+    // Multiply and add stay separate operations in both paths, a fused
+    // multiply-add would round differently.
+    simd_i weyl = simd_i_loadu(lanes);
+    simd_i step = simd_i_set1((int)((uint32_t)SIMD_WIDTH * SIMD_WEYL_STEP));
+    float scaleValue = 2.0f / (float)UINT32_MAX * extent;
+    simd_f scale = simd_set1(scaleValue);
+    simd_f offset = simd_loadu(centerLanes);
+
+    int i = 0;
+    int vectorEnd = floats / SIMD_WIDTH * SIMD_WIDTH;
+    for (; i < vectorEnd; i += SIMD_WIDTH) {
+        simd_f scaled = simd_mul(simd_i_to_f(SIMD_FN(scramble_lanes)(weyl)), scale);
+        simd_storeu(out + i, simd_add(scaled, offset));
+        weyl = simd_i_add(weyl, step);
+    }
+
+    for (; i < floats; i++) {
+        uint32_t r = SIMD_FN(scramble)(base + (uint32_t)i * SIMD_WEYL_STEP);
+        float scaled = (float)(int32_t)r * scaleValue;
+        out[i] = scaled + center[i & 1];
+    }
+}
+
+static void SIMD_FN(zero_velocities)(vec2* velocities, int count) {
+    float* out = (float*)velocities;
+    int floats = count * 2;
+    simd_f zero = simd_setzero();
+
+    int i = 0;
+    int vectorEnd = floats / SIMD_WIDTH * SIMD_WIDTH;
+    for (; i < vectorEnd; i += SIMD_WIDTH) {
+        simd_storeu(out + i, zero);
+    }
+    for (; i < floats; i++) {
+        out[i] = 0.0f;
+    }
+}
+
+// Same explicit Euler step as particle.comp
+static void SIMD_FN(integrate)(vec2* positions, vec2* velocities, float* speeds, int count, const SimdIntegrateParams* params) {
+    float* pos = (float*)positions;
+    float* vel = (float*)velocities;
+    int floats = count * 2;
+
+    float mouseLanes[SIMD_WIDTH];
+    for (int l = 0; l < SIMD_WIDTH; l++) {
+        mouseLanes[l] = params->mouse[l & 1];
+    }
+    simd_f mouse = simd_loadu(mouseLanes);
+    simd_f dt = simd_set1(params->deltaTime);
+    simd_f pull = simd_set1(params->attraction * params->deltaTime);
+    simd_f damping = simd_set1(params->damping);
+    simd_f epsilon = simd_set1(SIMD_NORMALIZE_EPSILON);
+
+    int i = 0;
+    int vectorEnd = floats / SIMD_WIDTH * SIMD_WIDTH;
+    for (; i < vectorEnd; i += SIMD_WIDTH) {
+        simd_f p = simd_loadu(pos + i);
+        simd_f v = simd_loadu(vel + i);
+
+        p = simd_add(p, simd_mul(v, dt));
+
+        simd_f d = simd_sub(mouse, p);
+        simd_f d2 = simd_mul(d, d);
+        simd_f lengthSq = simd_max(simd_add(d2, simd_swap_pairs(d2)), epsilon);
+        v = simd_add(v, simd_div(simd_mul(d, pull), simd_sqrt(lengthSq)));
+        v = simd_mul(v, damping);
+
+        simd_storeu(pos + i, p);
+        simd_storeu(vel + i, v);
+
+        if (speeds) {
+            simd_f v2 = simd_mul(v, v);
+            float speedLanes[SIMD_WIDTH];
+            simd_storeu(speedLanes, simd_sqrt(simd_add(v2, simd_swap_pairs(v2))));
+            for (int l = 0; l < SIMD_WIDTH; l += 2) {
+                speeds[(i + l) / 2] = speedLanes[l];
+            }
+        }
+    }
+
+    for (; i < floats; i += 2) {
+        pos[i] += vel[i] * params->deltaTime;
+        pos[i + 1] += vel[i + 1] * params->deltaTime;
+
+        float dx = params->mouse[0] - pos[i];
+        float dy = params->mouse[1] - pos[i + 1];
+        float length = sqrtf(fmaxf(dx * dx + dy * dy, SIMD_NORMALIZE_EPSILON));
+        vel[i] = (vel[i] + dx / length * params->attraction * params->deltaTime) * params->damping;
+        vel[i + 1] = (vel[i + 1] + dy / length * params->attraction * params->deltaTime) * params->damping;
+
+        if (speeds) {
+            speeds[i / 2] = sqrtf(vel[i] * vel[i] + vel[i + 1] * vel[i + 1]);
+        }
+    }
+}
+
+static inline void SIMD_FN(histogram_add)(unsigned int* histogram, float speedSq) {
+    int bin = (int)(sqrtf(speedSq) * (STATS_HISTOGRAM_BINS / STATS_HISTOGRAM_MAX_SPEED));
+    if (bin >= STATS_HISTOGRAM_BINS) bin = STATS_HISTOGRAM_BINS - 1;
+    histogram[bin]++;
+}
+
+// Elements accumulated in float lanes before flushing into doubles
+#define SIMD_FLUSH_BLOCK 4096
+
+static void SIMD_FN(reduce_stats)(const vec2* positions, const vec2* velocities, int count, SimdStatsResult* result) {
+    const float* pos = (const float*)positions;
+    const float* vel = (const float*)velocities;
+    int floats = count * 2;
+    memset(result, 0, sizeof(*result));
+
+    simd_f minPos = simd_set1(FLT_MAX);
+    simd_f maxPos = simd_set1(-FLT_MAX);
+    simd_f maxSpeedSq = simd_setzero();
+    double sumPos[2] = {0.0, 0.0};
+    double kinetic = 0.0;
+
+    int i = 0;
+    int vectorEnd = floats / SIMD_WIDTH * SIMD_WIDTH;
+    while (i < vectorEnd) {
+        int blockEnd = i + SIMD_FLUSH_BLOCK * 2;
+        if (blockEnd > vectorEnd) blockEnd = vectorEnd;
+
+        simd_f blockSum = simd_setzero();
+        simd_f blockKinetic = simd_setzero();
+        for (; i < blockEnd; i += SIMD_WIDTH) {
+            simd_f p = simd_loadu(pos + i);
+            simd_f v = simd_loadu(vel + i);
+
+            minPos = simd_min(minPos, p);
+            maxPos = simd_max(maxPos, p);
+            blockSum = simd_add(blockSum, p);
+
+            // |v|^2 per particle, duplicated in both lanes of its pair
+            simd_f v2 = simd_mul(v, v);
+            simd_f speedSq = simd_add(v2, simd_swap_pairs(v2));
+            blockKinetic = simd_add(blockKinetic, v2);
+            maxSpeedSq = simd_max(maxSpeedSq, speedSq);
+
+            float lanes[SIMD_WIDTH];
+            simd_storeu(lanes, speedSq);
+            for (int l = 0; l < SIMD_WIDTH; l += 2) {
+                SIMD_FN(histogram_add)(result->histogram, lanes[l]);
+            }
+        }
+
+        // Flush float lanes into double accumulators to keep precision at 65M
+        float sumLanes[SIMD_WIDTH], kineticLanes[SIMD_WIDTH];
+        simd_storeu(sumLanes, blockSum);
+        simd_storeu(kineticLanes, blockKinetic);
+        for (int l = 0; l < SIMD_WIDTH; l++) {
+            sumPos[l & 1] += sumLanes[l];
+            kinetic += kineticLanes[l];
+        }
+    }
+
+    float minLanes[SIMD_WIDTH], maxLanes[SIMD_WIDTH], speedLanes[SIMD_WIDTH];
+    simd_storeu(minLanes, minPos);
+    simd_storeu(maxLanes, maxPos);
+    simd_storeu(speedLanes, maxSpeedSq);
+
+    result->minPos[0] = result->minPos[1] = FLT_MAX;
+    result->maxPos[0] = result->maxPos[1] = -FLT_MAX;
+    result->maxSpeedSq = 0.0f;
+    for (int l = 0; l < SIMD_WIDTH; l++) {
+        result->minPos[l & 1] = fminf(result->minPos[l & 1], minLanes[l]);
+        result->maxPos[l & 1] = fmaxf(result->maxPos[l & 1], maxLanes[l]);
+        result->maxSpeedSq = fmaxf(result->maxSpeedSq, speedLanes[l]);
+    }
+
+    for (; i < floats; i += 2) {
+        float px = pos[i], py = pos[i + 1];
+        float vx = vel[i], vy = vel[i + 1];
+        float speedSq = vx * vx + vy * vy;
+        result->minPos[0] = fminf(result->minPos[0], px);
+        result->minPos[1] = fminf(result->minPos[1], py);
+        result->maxPos[0] = fmaxf(result->maxPos[0], px);
+        result->maxPos[1] = fmaxf(result->maxPos[1], py);
+        sumPos[0] += px;
+        sumPos[1] += py;
+        result->maxSpeedSq = fmaxf(result->maxSpeedSq, speedSq);
+        kinetic += speedSq;
+        SIMD_FN(histogram_add)(result->histogram, speedSq);
+    }
+
+    result->sumPos[0] = sumPos[0];
+    result->sumPos[1] = sumPos[1];
+    result->kinetic = 0.5 * kinetic;
+}
+
+// Stable-fluids rows, see fluid.c. Grids are (size + 2)^2 floats with a one
+// cell boundary ring, each call covers the interior cells of one row.
+
+static inline float SIMD_FN(bilerp)(const float* field, int stride, int x0, int y0, float sx, float sy) {
+    const float* p = field + y0 * stride + x0;
+    return (1.0f - sy) * ((1.0f - sx) * p[0] + sx * p[1]) +
+           sy * ((1.0f - sx) * p[stride] + sx * p[stride + 1]);
+}
+
+static inline void SIMD_FN(advect_cell)(float* outU, float* outV, const float* u, const float* v,
+                                        int stride, int x0, int y0, float sx, float sy, int cell, float decay) {
+    outU[cell] = decay * SIMD_FN(bilerp)(u, stride, x0, y0, sx, sy);
+    outV[cell] = decay * SIMD_FN(bilerp)(v, stride, x0, y0, sx, sy);
+}
+
+// Semi-Lagrangian self-advection: trace each cell back by dt0 cells of
+// velocity and sample the old field there. The trace is vectorized, the
+// bilinear gathers are scalar.
+static void SIMD_FN(fluid_advect_row)(float* outU, float* outV, const float* u, const float* v,
+                                      int row, int size, float dt0, float decay) {
+    int stride = size + 2;
+    float laneOffsets[SIMD_WIDTH];
+    for (int l = 0; l < SIMD_WIDTH; l++) {
+        laneOffsets[l] = (float)l;
+    }
+    simd_f lanes = simd_loadu(laneOffsets);
+    simd_f dt = simd_set1(dt0);
+    simd_f lo = simd_set1(0.5f);
+    simd_f hi = simd_set1(size + 0.5f);
+    simd_f rowY = simd_set1((float)row);
+
+    int i = 1;
+    int vectorEnd = 1 + size / SIMD_WIDTH * SIMD_WIDTH;
+    for (; i < vectorEnd; i += SIMD_WIDTH) {
+        int cell = row * stride + i;
+        simd_f x = simd_sub(simd_add(simd_set1((float)i), lanes), simd_mul(dt, simd_loadu(u + cell)));
+        simd_f y = simd_sub(rowY, simd_mul(dt, simd_loadu(v + cell)));
+        x = simd_min(simd_max(x, lo), hi);
+        y = simd_min(simd_max(y, lo), hi);
+
+        // Coordinates are positive, truncation is floor
+        simd_i xi = simd_f_to_i(x);
+        simd_i yi = simd_f_to_i(y);
+        int x0[SIMD_WIDTH], y0[SIMD_WIDTH];
+        float sx[SIMD_WIDTH], sy[SIMD_WIDTH];
+        simd_i_storeu(x0, xi);
+        simd_i_storeu(y0, yi);
+        simd_storeu(sx, simd_sub(x, simd_i_to_f(xi)));
+        simd_storeu(sy, simd_sub(y, simd_i_to_f(yi)));
+
+        for (int l = 0; l < SIMD_WIDTH; l++) {
+            SIMD_FN(advect_cell)(outU, outV, u, v, stride, x0[l], y0[l], sx[l], sy[l], cell + l, decay);
+        }
+    }
+
+    for (; i <= size; i++) {
+        int cell = row * stride + i;
+        float x = fminf(fmaxf(i - dt0 * u[cell], 0.5f), size + 0.5f);
+        float y = fminf(fmaxf(row - dt0 * v[cell], 0.5f), size + 0.5f);
+        int x0 = (int)x;
+        int y0 = (int)y;
+        SIMD_FN(advect_cell)(outU, outV, u, v, stride, x0, y0, x - x0, y - y0, cell, decay);
+    }
+}
+
+// Central-difference divergence times scale
+static void SIMD_FN(fluid_divergence_row)(float* divergence, const float* u, const float* v,
+                                          int row, int size, float scale) {
+    int stride = size + 2;
+    simd_f s = simd_set1(scale);
+
+    int i = 1;
+    int vectorEnd = 1 + size / SIMD_WIDTH * SIMD_WIDTH;
+    for (; i < vectorEnd; i += SIMD_WIDTH) {
+        int cell = row * stride + i;
+        simd_f du = simd_sub(simd_loadu(u + cell + 1), simd_loadu(u + cell - 1));
+        simd_f dv = simd_sub(simd_loadu(v + cell + stride), simd_loadu(v + cell - stride));
+        simd_storeu(divergence + cell, simd_mul(s, simd_add(du, dv)));
+    }
+    for (; i <= size; i++) {
+        int cell = row * stride + i;
+        divergence[cell] = scale * (u[cell + 1] - u[cell - 1] + v[cell + stride] - v[cell - stride]);
+    }
+}
+
+// One Jacobi sweep of the pressure Poisson equation
+static void SIMD_FN(fluid_jacobi_row)(float* out, const float* pressure, const float* divergence,
+                                      int row, int size) {
+    int stride = size + 2;
+    simd_f quarter = simd_set1(0.25f);
+
+    int i = 1;
+    int vectorEnd = 1 + size / SIMD_WIDTH * SIMD_WIDTH;
+    for (; i < vectorEnd; i += SIMD_WIDTH) {
+        int cell = row * stride + i;
+        simd_f sum = simd_add(simd_loadu(pressure + cell - 1), simd_loadu(pressure + cell + 1));
+        sum = simd_add(sum, simd_add(simd_loadu(pressure + cell - stride), simd_loadu(pressure + cell + stride)));
+        simd_storeu(out + cell, simd_mul(quarter, simd_add(sum, simd_loadu(divergence + cell))));
+    }
+    for (; i <= size; i++) {
+        int cell = row * stride + i;
+        out[cell] = 0.25f * (pressure[cell - 1] + pressure[cell + 1] +
+                             pressure[cell - stride] + pressure[cell + stride] + divergence[cell]);
+    }
+}
+
+// Subtract the pressure gradient times scale, leaving the field divergence free
+static void SIMD_FN(fluid_gradient_row)(float* u, float* v, const float* pressure, int row, int size, float scale) {
+    int stride = size + 2;
+    simd_f s = simd_set1(scale);
+
+    int i = 1;
+    int vectorEnd = 1 + size / SIMD_WIDTH * SIMD_WIDTH;
+    for (; i < vectorEnd; i += SIMD_WIDTH) {
+        int cell = row * stride + i;
+        simd_f dx = simd_sub(simd_loadu(pressure + cell + 1), simd_loadu(pressure + cell - 1));
+        simd_f dy = simd_sub(simd_loadu(pressure + cell + stride), simd_loadu(pressure + cell - stride));
+        simd_storeu(u + cell, simd_sub(simd_loadu(u + cell), simd_mul(s, dx)));
+        simd_storeu(v + cell, simd_sub(simd_loadu(v + cell), simd_mul(s, dy)));
+    }
+    for (; i <= size; i++) {
+        int cell = row * stride + i;
+        u[cell] -= scale * (pressure[cell + 1] - pressure[cell - 1]);
+        v[cell] -= scale * (pressure[cell + stride] - pressure[cell - stride]);
+    }
+}
+
+const SimdKernels SIMD_TABLE = {
+    SIMD_ISA,
+    SIMD_FN(init_positions),
+    SIMD_FN(zero_velocities),
+    SIMD_FN(integrate),
+    SIMD_FN(reduce_stats),
+    SIMD_FN(fluid_advect_row),
+    SIMD_FN(fluid_divergence_row),
+    SIMD_FN(fluid_jacobi_row),
+    SIMD_FN(fluid_gradient_row),
+};
@@ -0,0 +1,36 @@
+#include "simd_kernels.h"
+#include <xmmintrin.h>  // SSE
+#include <emmintrin.h>  // SSE2
+
+#define SIMD_WIDTH 4
+#define SIMD_ISA SIMD_ISA_SSE2
+#define SIMD_TABLE simd_kernels_sse2
+#define SIMD_FN(name) name##_sse2
+
+typedef __m128 simd_f;
+typedef __m128i simd_i;
+
+#define simd_set1(x)        _mm_set1_ps(x)
+#define simd_setzero()      _mm_setzero_ps()
+#define simd_loadu(p)       _mm_loadu_ps(p)
+#define simd_storeu(p, v)   _mm_storeu_ps(p, v)
+#define simd_add(a, b)      _mm_add_ps(a, b)
+#define simd_sub(a, b)      _mm_sub_ps(a, b)
+#define simd_mul(a, b)      _mm_mul_ps(a, b)
+#define simd_div(a, b)      _mm_div_ps(a, b)
+#define simd_min(a, b)      _mm_min_ps(a, b)
+#define simd_max(a, b)      _mm_max_ps(a, b)
+#define simd_sqrt(a)        _mm_sqrt_ps(a)
+#define simd_swap_pairs(v)  _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1))
+
+#define simd_i_loadu(p)     _mm_loadu_si128((const __m128i*)(p))
+#define simd_i_xor(a, b)    _mm_xor_si128(a, b)
+#define simd_i_add(a, b)    _mm_add_epi32(a, b)
+#define simd_i_set1(x)      _mm_set1_epi32(x)
+#define simd_i_slli(v, n)   _mm_slli_epi32(v, n)
+#define simd_i_srli(v, n)   _mm_srli_epi32(v, n)
+#define simd_i_to_f(v)      _mm_cvtepi32_ps(v)
+#define simd_f_to_i(v)      _mm_cvttps_epi32(v)  // Truncates
+#define simd_i_storeu(p, v) _mm_storeu_si128((__m128i*)(p), v)
+
+#include "simd_kernels.inl"
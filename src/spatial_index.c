@@ -0,0 +1,328 @@
+#include "spatial_index.h"
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+// Matches struct QueryResult in spatial_index.comp (std430)
+typedef struct {
+    unsigned int matches;
+    unsigned int stored;
+} SpatialQueryResult;
+
+static int cell_count(const SpatialIndex* index) {
+    return index->resolution * index->resolution;
+}
+
+static int block_count(const SpatialIndex* index) {
+    return (cell_count(index) + SPATIAL_SCAN_SIZE - 1) / SPATIAL_SCAN_SIZE;
+}
+
+static unsigned int create_storage(GLsizeiptr size) {
+    unsigned int buffer;
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, size, NULL, GL_DYNAMIC_COPY);
+    return buffer;
+}
+
+void spatial_index_init(SpatialIndex* index, float extent, int resolution) {
+    memset(index, 0, sizeof(*index));
+    // The block offsets are scanned by one workgroup
+    if (resolution * resolution > SPATIAL_SCAN_SIZE * SPATIAL_SCAN_SIZE) {
+        resolution = SPATIAL_SCAN_SIZE;
+    }
+    index->resolution = resolution;
+    index->extent = extent;
+    index->cellSize = 2.0f * extent / resolution;
+
+    // Buffers and stage programs wait for the first build, most sessions never query
+    const char* path = "shaders/spatial_index.comp";
+    GLenum type = GL_COMPUTE_SHADER;
+    shader_variant_cache_init(&index->stages, "Spatial index", &path, &type, 1);
+}
+
+static bool allocate(SpatialIndex* index, int capacity) {
+    // Errors left by earlier calls would read as a failed allocation
+    while (glGetError() != GL_NO_ERROR) {
+    }
+
+    int cells = cell_count(index);
+    index->countBuffer = create_storage((GLsizeiptr)cells * sizeof(unsigned int));
+    index->startBuffer = create_storage((GLsizeiptr)(cells + 1) * sizeof(unsigned int));
+    index->blockBuffer = create_storage((GLsizeiptr)block_count(index) * sizeof(unsigned int));
+    index->indexBuffer = create_storage((GLsizeiptr)capacity * sizeof(unsigned int));
+    index->resultBuffer = create_storage(sizeof(SpatialQueryResult));
+    index->selectionBuffer = create_storage((GLsizeiptr)SPATIAL_QUERY_MAX_RESULTS * sizeof(unsigned int));
+
+    glGenQueries(SPATIAL_READBACK_FRAMES, index->buildQueries);
+    glGenQueries(SPATIAL_READBACK_FRAMES, index->queryQueries);
+    glGenBuffers(SPATIAL_READBACK_FRAMES, index->readbackBuffers);
+    for (int i = 0; i < SPATIAL_READBACK_FRAMES; i++) {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, index->readbackBuffers[i]);
+        glBufferData(GL_COPY_WRITE_BUFFER, sizeof(SpatialQueryResult), NULL, GL_STREAM_READ);
+    }
+
+    bool outOfMemory = false;
+    for (GLenum error = glGetError(); error != GL_NO_ERROR; error = glGetError()) {
+        outOfMemory = outOfMemory || error == GL_OUT_OF_MEMORY;
+    }
+    if (outOfMemory) {
+        fprintf(stderr, "Failed to allocate spatial index for %d particles\n", capacity);
+        index->capacity = -1;  // Not retried every frame, released in cleanup
+        return false;
+    }
+    index->capacity = capacity;
+    printf("Spatial index: %dx%d cells, %zu MB\n", index->resolution, index->resolution,
+           ((size_t)capacity + 2 * cells) * sizeof(unsigned int) >> 20);
+    return true;
+}
+
+static unsigned int stage_program(SpatialIndex* index, int stage, bool flags) {
+    unsigned int* program = stage == SPATIAL_STAGE_QUERY && flags ? &index->queryFlagsProgram
+                                                                 : &index->stagePrograms[stage];
+    if (!*program) {
+        char value[8];
+        snprintf(value, sizeof(value), "%d", stage);
+        ShaderDefine defines[] = {
+            {"SPATIAL_STAGE", value},
+            {"PARTICLE_FLAGS", flags ? "1" : "0"},
+        };
+        *program = shader_variant_cache_get(&index->stages, defines, sizeof(defines) / sizeof(defines[0]));
+    }
+    return *program;
+}
+
+static unsigned int use_stage(SpatialIndex* index, int stage, bool flags) {
+    unsigned int program = stage_program(index, stage, flags);
+    glUseProgram(program);
+    glUniform1i(glGetUniformLocation(program, "resolution"), index->resolution);
+    glUniform1f(glGetUniformLocation(program, "extent"), index->extent);
+    glUniform1f(glGetUniformLocation(program, "inv_cell_size"), 1.0f / index->cellSize);
+    glUniform1ui(glGetUniformLocation(program, "cell_count"), cell_count(index));
+    glUniform1ui(glGetUniformLocation(program, "block_count"), block_count(index));
+    return program;
+}
+
+// One dispatch per group range, the pool has gaps between groups
+static void dispatch_ranges(const ParticleSystem* ps, unsigned int program) {
+    GLint firstLocation = glGetUniformLocation(program, "range_first");
+    GLint countLocation = glGetUniformLocation(program, "range_count");
+    for (int i = 0; i < ps->tableCount; i++) {
+        glUniform1ui(firstLocation, ps->drawFirsts[i]);
+        glUniform1ui(countLocation, ps->drawCounts[i]);
+        glDispatchCompute((ps->drawCounts[i] + SPATIAL_LOCAL_SIZE - 1) / SPATIAL_LOCAL_SIZE, 1, 1);
+    }
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+// Timings and the match count of a few frames ago, never waits. Returns
+// false while the GPU still owns the slot.
+static bool poll_readback(SpatialIndex* index, int slot) {
+    GLsync fence = index->fences[slot];
+    if (!fence) {
+        return true;
+    }
+
+    GLenum status = glClientWaitSync(fence, 0, 0);
+    if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+        return false;
+    }
+
+    GLuint64 ns = 0;
+    glGetQueryObjectui64v(index->buildQueries[slot], GL_QUERY_RESULT, &ns);
+    index->buildTimeMs = ns / 1000000.0f;
+    if (index->queried[slot]) {
+        SpatialQueryResult result;
+        glBindBuffer(GL_COPY_READ_BUFFER, index->readbackBuffers[slot]);
+        glGetBufferSubData(GL_COPY_READ_BUFFER, 0, sizeof(result), &result);
+        glGetQueryObjectui64v(index->queryQueries[slot], GL_QUERY_RESULT, &ns);
+        index->queryTimeMs = ns / 1000000.0f;
+        index->matches = (int)result.matches;
+    }
+
+    glDeleteSync(fence);
+    index->fences[slot] = NULL;
+    return true;
+}
+
+void spatial_index_build(SpatialIndex* index, ParticleSystem* ps) {
+    index->built = false;
+    if (index->capacity < 0 || (index->capacity == 0 && !allocate(index, ps->numParticles))) {
+        return;
+    }
+
+    // A slot still in flight keeps its fence, this frame goes untimed
+    int slot = index->frame % SPATIAL_READBACK_FRAMES;
+    index->recording = poll_readback(index, slot);
+    if (index->recording) {
+        index->queried[slot] = false;
+    }
+
+    unsigned int zero = 0;
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, index->countBuffer);
+    glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, ps->positionBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SPATIAL_BINDING_COUNTS, index->countBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SPATIAL_BINDING_STARTS, index->startBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SPATIAL_BINDING_BLOCKS, index->blockBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SPATIAL_BINDING_INDICES, index->indexBuffer);
+
+    if (index->recording) {
+        glBeginQuery(GL_TIME_ELAPSED, index->buildQueries[slot]);
+    }
+    dispatch_ranges(ps, use_stage(index, SPATIAL_STAGE_COUNT_CELLS, false));
+
+    // Counts to cell starts, a block scan, a scan of the block totals and a fixup
+    use_stage(index, SPATIAL_STAGE_SCAN_BLOCKS, false);
+    glDispatchCompute(block_count(index), 1, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    use_stage(index, SPATIAL_STAGE_SCAN_TOTALS, false);
+    glDispatchCompute(1, 1, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    use_stage(index, SPATIAL_STAGE_ADD_OFFSETS, false);
+    glDispatchCompute(block_count(index), 1, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    // The counts are now the fill cursor of each cell
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, index->countBuffer);
+    glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+    dispatch_ranges(ps, use_stage(index, SPATIAL_STAGE_SCATTER, false));
+    if (index->recording) {
+        glEndQuery(GL_TIME_ELAPSED);
+    }
+
+    index->built = true;
+}
+
+void spatial_index_query(SpatialIndex* index, ParticleSystem* ps, const SpatialQuery* query,
+                         const Brush* brush, float deltaTime) {
+    if (!index->built) {
+        return;
+    }
+    int slot = index->frame % SPATIAL_READBACK_FRAMES;
+
+    // Marks are allocated by the first brush that sets one
+    bool marks = brush->op == BRUSH_FREEZE || brush->op == BRUSH_THAW ||
+                 brush->op == BRUSH_RECOLOR || brush->op == BRUSH_DELETE;
+    if (marks) {
+        particle_system_enable_flags(ps);
+    }
+    bool flags = ps->flagsInUse;
+
+    // Cells overlapping the region's bounding square
+    float half[2] = { query->radius, query->radius };
+    if (query->shape == SPATIAL_QUERY_BOX) {
+        half[0] = query->halfExtent[0];
+        half[1] = query->halfExtent[1];
+    }
+    int cellMin[2], cellMax[2];
+    for (int axis = 0; axis < 2; axis++) {
+        float low = (query->center[axis] - half[axis] + index->extent) / index->cellSize;
+        float high = (query->center[axis] + half[axis] + index->extent) / index->cellSize;
+        cellMin[axis] = (int)floorf(fmaxf(low, 0.0f));
+        cellMax[axis] = (int)floorf(fminf(high, (float)(index->resolution - 1)));
+        if (cellMin[axis] > index->resolution - 1) cellMin[axis] = index->resolution - 1;
+        if (cellMax[axis] < 0) cellMax[axis] = 0;
+    }
+    int cellsX = cellMax[0] - cellMin[0] + 1;
+    int cellsY = cellMax[1] - cellMin[1] + 1;
+    index->cellsVisited = cellsX * cellsY;
+
+    SpatialQueryResult cleared = { 0, 0 };
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, index->resultBuffer);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(cleared), &cleared);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, ps->positionBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, ps->velocityBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SPATIAL_BINDING_STARTS, index->startBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SPATIAL_BINDING_INDICES, index->indexBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SPATIAL_BINDING_RESULT, index->resultBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SPATIAL_BINDING_SELECTION, index->selectionBuffer);
+    if (brush->species >= 0) {
+        // Single species scenes never needed the ids until now
+        particle_system_enable_species(ps);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, PARTICLE_SPECIES_BINDING, ps->speciesBuffer);
+    }
+    if (flags) {
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, PARTICLE_FLAGS_BINDING, ps->flagBuffer);
+    }
+
+    unsigned int program = use_stage(index, SPATIAL_STAGE_QUERY, flags);
+    glUniform2i(glGetUniformLocation(program, "cell_min"), cellMin[0], cellMin[1]);
+    glUniform1i(glGetUniformLocation(program, "shape"), query->shape);
+    glUniform2fv(glGetUniformLocation(program, "center"), 1, query->center);
+    glUniform1f(glGetUniformLocation(program, "radius"), query->radius);
+    glUniform2fv(glGetUniformLocation(program, "half_extent"), 1, query->halfExtent);
+    glUniform1i(glGetUniformLocation(program, "op"), brush->op);
+    glUniform1f(glGetUniformLocation(program, "impulse"), brush->strength * deltaTime);
+    glUniform1ui(glGetUniformLocation(program, "palette_bits"),
+                 (unsigned int)(brush->palette + 1) << PARTICLE_FLAG_PALETTE_SHIFT);
+    glUniform1ui(glGetUniformLocation(program, "max_results"), SPATIAL_QUERY_MAX_RESULTS);
+    glUniform1i(glGetUniformLocation(program, "species_filter"), brush->species);
+
+    // One workgroup per cell, the cost follows the particles under the region
+    if (index->recording) {
+        glBeginQuery(GL_TIME_ELAPSED, index->queryQueries[slot]);
+    }
+    glDispatchCompute(cellsX, cellsY, 1);
+    if (index->recording) {
+        glEndQuery(GL_TIME_ELAPSED);
+    }
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+
+    if (index->recording) {
+        glBindBuffer(GL_COPY_READ_BUFFER, index->resultBuffer);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, index->readbackBuffers[slot]);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, sizeof(SpatialQueryResult));
+        index->queried[slot] = true;
+    }
+
+    // Pushed or thawed particles may sit in tiles the sparse update put to rest
+    if (brush->op == BRUSH_PUSH || brush->op == BRUSH_THAW) {
+        ps->tilesStale = true;
+    }
+}
+
+void spatial_index_end_frame(SpatialIndex* index) {
+    if (!index->built) {
+        return;
+    }
+    int slot = index->frame % SPATIAL_READBACK_FRAMES;
+    if (index->recording) {
+        index->fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+    index->frame++;
+    index->built = false;
+}
+
+void spatial_index_cleanup(SpatialIndex* index) {
+    if (index->capacity != 0) {
+        for (int i = 0; i < SPATIAL_READBACK_FRAMES; i++) {
+            if (index->fences[i]) {
+                glDeleteSync(index->fences[i]);
+                index->fences[i] = NULL;
+            }
+        }
+        unsigned int buffers[] = { index->countBuffer, index->startBuffer, index->blockBuffer,
+                                   index->indexBuffer, index->resultBuffer, index->selectionBuffer };
+        glDeleteBuffers(sizeof(buffers) / sizeof(buffers[0]), buffers);
+        glDeleteBuffers(SPATIAL_READBACK_FRAMES, index->readbackBuffers);
+        glDeleteQueries(SPATIAL_READBACK_FRAMES, index->buildQueries);
+        glDeleteQueries(SPATIAL_READBACK_FRAMES, index->queryQueries);
+    }
+    shader_variant_cache_cleanup(&index->stages);
+    index->capacity = 0;
+}
+
+const char* brush_op_name(int op) {
+    switch (op) {
+        case BRUSH_SELECT: return "Select";
+        case BRUSH_PUSH: return "Push";
+        case BRUSH_FREEZE: return "Freeze";
+        case BRUSH_THAW: return "Thaw";
+        case BRUSH_RECOLOR: return "Recolor";
+        case BRUSH_DELETE: return "Delete";
+        default: return "None";
+    }
+}
@@ -3,6 +3,7 @@
 #include "imgui_impl_opengl3.h"
 #include "ui.h"
 #include "world.h"
+#include <stdio.h>
 
 extern "C" {
 
@@ -56,6 +57,8 @@ void ui_render(UI* ui, World* world) {
                 if (ImGui::MenuItem("Open", "Ctrl+O")) {}
                 if (ImGui::MenuItem("Save", "Ctrl+S")) {}
                 ImGui::Separator();
+                ImGui::MenuItem("Share Particles", NULL, &world->exporter.enabled);
+                ImGui::Separator();
                 if (ImGui::MenuItem("Exit", "Alt+F4")) {
                     glfwSetWindowShouldClose(ui->window, 1);
                 }
@@ -68,11 +71,136 @@ void ui_render(UI* ui, World* world) {
                 }
                 ImGui::EndMenu();
             }
+
+            if (ImGui::BeginMenu("Brush")) {
+                Brush* brush = &world->brush;
+                for (int op = BRUSH_NONE; op < BRUSH_OP_COUNT; op++) {
+                    if (ImGui::MenuItem(brush_op_name(op), NULL, brush->op == op)) {
+                        brush->op = op;
+                    }
+                }
+                ImGui::Separator();
+                if (ImGui::MenuItem("Circle", NULL, brush->shape == SPATIAL_QUERY_RADIUS)) {
+                    brush->shape = SPATIAL_QUERY_RADIUS;
+                }
+                if (ImGui::MenuItem("Box", NULL, brush->shape == SPATIAL_QUERY_BOX)) {
+                    brush->shape = SPATIAL_QUERY_BOX;
+                }
+                if (ImGui::BeginMenu("Size")) {
+                    static const float radii[] = { 0.25f, 0.5f, 1.0f, 2.0f, 5.0f };
+                    for (int i = 0; i < (int)(sizeof(radii) / sizeof(radii[0])); i++) {
+                        char label[32];
+                        snprintf(label, sizeof(label), "%.2f", radii[i]);
+                        if (ImGui::MenuItem(label, NULL, brush->radius == radii[i])) {
+                            brush->radius = radii[i];
+                        }
+                    }
+                    ImGui::EndMenu();
+                }
+                if (ImGui::BeginMenu("Species")) {
+                    if (ImGui::MenuItem("All", NULL, brush->species < 0)) {
+                        brush->species = -1;
+                    }
+                    for (int i = 0; i < world->particles.speciesCount; i++) {
+                        if (ImGui::MenuItem(world->particles.species[i].name, NULL, brush->species == i)) {
+                            brush->species = i;
+                        }
+                    }
+                    ImGui::EndMenu();
+                }
+                if (ImGui::BeginMenu("Recolor Palette")) {
+                    for (int i = 0; i < COLORMAP_COUNT; i++) {
+                        if (ImGui::MenuItem(colormap_palette_name(i), NULL, brush->palette == i)) {
+                            brush->palette = i;
+                        }
+                    }
+                    ImGui::EndMenu();
+                }
+                ImGui::Separator();
+                if (ImGui::MenuItem("Clear Marks")) {
+                    particle_system_clear_flags(&world->particles);
+                }
+                ImGui::EndMenu();
+            }
+
+            if (ImGui::BeginMenu("Scene")) {
+                if (ImGui::MenuItem("Single System")) {
+                    world_load_scene(world, 1, 1);
+                }
+                if (ImGui::MenuItem("16 Systems")) {
+                    world_load_scene(world, 16, 1);
+                }
+                if (ImGui::MenuItem("64 Systems")) {
+                    world_load_scene(world, 64, 1);
+                }
+                ImGui::Separator();
+                if (ImGui::MenuItem("Mixed Species")) {
+                    world_load_scene(world, 1, world->particles.speciesCount);
+                }
+                if (ImGui::MenuItem("16 Systems, Mixed Species")) {
+                    world_load_scene(world, 16, world->particles.speciesCount);
+                }
+                ImGui::EndMenu();
+            }
             
             if (ImGui::BeginMenu("View")) {
                 if (ImGui::MenuItem("Toggle Grid")) {
                     // TODO: Add grid toggle functionality
                 }
+                ImGui::MenuItem("Adaptive Particle Budget", NULL, &world->budget.enabled);
+                if (ImGui::BeginMenu("Integrator")) {
+                    ParticleKernelConfig* kernel = &world->particles.kernel;
+                    if (ImGui::MenuItem("Explicit Euler", NULL, kernel->integrator == PARTICLE_INTEGRATOR_EULER)) {
+                        kernel->integrator = PARTICLE_INTEGRATOR_EULER;
+                    }
+                    if (ImGui::MenuItem("Symplectic Euler", NULL, kernel->integrator == PARTICLE_INTEGRATOR_SYMPLECTIC_EULER)) {
+                        kernel->integrator = PARTICLE_INTEGRATOR_SYMPLECTIC_EULER;
+                    }
+                    ImGui::EndMenu();
+                }
+                if (ImGui::BeginMenu("Force Radius")) {
+                    static const float radii[] = { 0.0f, 5.0f, 10.0f, 20.0f };
+                    for (int i = 0; i < (int)(sizeof(radii) / sizeof(radii[0])); i++) {
+                        char label[32];
+                        if (radii[i] > 0.0f) {
+                            snprintf(label, sizeof(label), "%.0f", radii[i]);
+                        } else {
+                            snprintf(label, sizeof(label), "Unlimited");
+                        }
+                        if (ImGui::MenuItem(label, NULL, world->particles.forceRadius == radii[i])) {
+                            world->particles.forceRadius = radii[i];
+                        }
+                    }
+                    ImGui::EndMenu();
+                }
+                ImGui::MenuItem("Sparse Updates", NULL, &world->particles.activity.enabled,
+                                world->particles.forceRadius > 0.0f);
+                ImGui::MenuItem("Fused Vertex Update", NULL, &world->particles.fused,
+                                world->particles.fusedSupported);
+                if (ImGui::BeginMenu("Fluid")) {
+                    FluidField* fluid = &world->fluid;
+                    ImGui::MenuItem("Enabled (left drag)", NULL, &fluid->enabled);
+                    if (ImGui::MenuItem("CPU Solver", NULL, fluid->solver == FLUID_SOLVER_CPU)) {
+                        fluid->solver = FLUID_SOLVER_CPU;
+                    }
+                    if (ImGui::MenuItem("GPU Solver", NULL, fluid->solver == FLUID_SOLVER_GPU)) {
+                        fluid->solver = FLUID_SOLVER_GPU;
+                    }
+                    if (ImGui::MenuItem("Reset")) {
+                        fluid_reset(fluid);
+                    }
+                    ImGui::EndMenu();
+                }
+                ImGui::MenuItem("Live Statistics", NULL, &world->particles.stats.enabled);
+                if (ImGui::BeginMenu("Palette")) {
+                    Colormap* colormap = &world->particles.colormap;
+                    for (int i = 0; i < COLORMAP_COUNT; i++) {
+                        if (ImGui::MenuItem(colormap_palette_name(i), NULL, colormap->palette == i)) {
+                            particle_system_set_palette(&world->particles, i);
+                        }
+                    }
+                    ImGui::EndMenu();
+                }
                 ImGui::EndMenu();
             }
             
@@ -85,6 +213,10 @@ void ui_toggle(UI* ui) {
     ui->show_ui = !ui->show_ui;
 }
 
+bool ui_wants_mouse(void) {
+    return ImGui::GetCurrentContext() && ImGui::GetIO().WantCaptureMouse;
+}
+
 void ui_end_frame() {
     ImGui::Render();
     ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
@@ -4,21 +4,80 @@
 #include "hud.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <xmmintrin.h>  // SSE
 #include <emmintrin.h>  // SSE2
 #include <math.h>
 #include <GLFW/glfw3.h>
 #include "particle_system.h"
+#include "job_system.h"
+#include "kernel_tuner.h"
+
+#define GRID_SIZE 10.0f
+#define GRID_SPACING 1.0f
+
+// GPU time allowed for particle step + draw per frame
+#define PARTICLE_BUDGET_MS 12.0f
+#define PARTICLE_BUDGET_MIN 100000
+
+// Frames per path of the fused/two-pass comparison, timer results lag a few frames
+#define RENDER_BENCH_WARMUP 30
+#define RENDER_BENCH_FRAMES 300
+
+#define BRUSH_DEFAULT_RADIUS 1.0f
+#define BRUSH_DEFAULT_STRENGTH 20.0f
+
+static void generate_grid_job(void* data) {
+    grid_generate_vertices((Grid*)data, GRID_SIZE, GRID_SPACING);
+}
 
 void world_init(World* world, GLFWwindow* window) {
     // Store window
     world->window = window;
-    
-    // Initialize grid
-    grid_init(&world->grid, 10.0f, 1.0f);
+
+    // Grid vertices are built on a worker while the particle system loads
+    JobCounter gridJob;
+    memset(&gridJob, 0, sizeof(gridJob));
+    world->grid.vertices = NULL;
+    job_submit(&gridJob, generate_grid_job, &world->grid);
     
     // Initialize particle system
     particle_system_init(&world->particles);
+
+    // Fluid velocity field over the grid, off until enabled from the menu
+    fluid_init(&world->fluid, GRID_SIZE, FLUID_RESOLUTION);
+    world->particles.fluid = &world->fluid;
+
+    // Shared memory export for other processes, off until enabled from the menu
+    particle_export_init(&world->exporter, PARTICLE_EXPORT_CAPACITY);
+
+    // Spatial index for brushes, built only on frames a brush is applied
+    spatial_index_init(&world->spatialIndex, SPATIAL_INDEX_EXTENT, SPATIAL_INDEX_RESOLUTION);
+    world->brush.op = BRUSH_NONE;
+    world->brush.shape = SPATIAL_QUERY_RADIUS;
+    world->brush.radius = BRUSH_DEFAULT_RADIUS;
+    world->brush.strength = BRUSH_DEFAULT_STRENGTH;
+    world->brush.palette = 0;
+    world->brush.species = -1;
+
+    // Initialize particle budget controller
+    budget_init(&world->budget, PARTICLE_BUDGET_MS, PARTICLE_BUDGET_MIN,
+                world->particles.numParticles, 256);
+
+    // Start with a single system filling the pool. Its particles are generated
+    // on the workers and streamed in over the first frames.
+    world_load_scene(world, 1, 1);
+
+    // Shaders compile while the workers generate particles
+    particle_system_load_shaders(&world->particles);
+
+    // Candidates are timed once the particles are loaded, the default kernel
+    // runs until the fastest is known
+    kernel_tuner_init(&world->kernelTuner, &world->particles);
+
+    // Initialize grid
+    job_wait(&gridJob);
+    grid_init(&world->grid, GRID_SIZE, GRID_SPACING);
     
     // Initialize UI
     ui_init(&world->ui, world->window);
@@ -27,6 +86,141 @@ void world_init(World* world, GLFWwindow* window) {
     hud_init(&world->hud);
 }
 
+void world_request_render_benchmark(World* world) {
+    memset(&world->renderBenchmark, 0, sizeof(world->renderBenchmark));
+    world->renderBenchmark.requested = true;
+    world->renderBenchmark.countPhase = -1;
+}
+
+// The index is rebuilt from this frame's positions only on frames the
+// brush is applied, i.e. while the right button is held outside the UI
+static void apply_brush(World* world, float deltaTime) {
+    const Brush* brush = &world->brush;
+    if (brush->op == BRUSH_NONE || world->particles.count == 0 ||
+        glfwGetMouseButton(world->window, GLFW_MOUSE_BUTTON_RIGHT) != GLFW_PRESS || ui_wants_mouse()) {
+        return;
+    }
+
+    SpatialQuery query;
+    query.shape = brush->shape;
+    query.center[0] = world->particles.mousePos[0];
+    query.center[1] = world->particles.mousePos[1];
+    query.radius = brush->radius;
+    query.halfExtent[0] = brush->radius;
+    query.halfExtent[1] = brush->radius;
+
+    spatial_index_build(&world->spatialIndex, &world->particles);
+    spatial_index_query(&world->spatialIndex, &world->particles, &query, brush, deltaTime);
+    spatial_index_end_frame(&world->spatialIndex);
+}
+
+// Needs GL 4.6 or ARB_pipeline_statistics_query, the context only asks for 4.3
+static bool invocation_count_supported(void) {
+    if (GLAD_GL_VERSION_4_6) {
+        return true;
+    }
+    GLint extensions = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &extensions);
+    for (GLint i = 0; i < extensions; i++) {
+        const char* name = (const char*)glGetStringi(GL_EXTENSIONS, i);
+        if (name && strcmp(name, "GL_ARB_pipeline_statistics_query") == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void report_invocations(RenderBenchmark* bench, const char* const* names) {
+    if (!bench->invocationQueries[0]) {
+        printf("Vertex shader invocations not countable here, double stepping unchecked\n");
+        return;
+    }
+    for (int phase = 0; phase < 2; phase++) {
+        if (bench->drawnParticles[phase] == 0) {
+            continue;
+        }
+        // Long finished, the benchmark ran hundreds of frames since
+        GLuint64 invocations = 0;
+        glGetQueryObjectui64v(bench->invocationQueries[phase], GL_QUERY_RESULT, &invocations);
+        double perParticle = (double)invocations / bench->drawnParticles[phase];
+        printf("%-9s %.3f vertex shader invocations per particle\n", names[phase], perParticle);
+        if (phase == 1 && invocations > (GLuint64)bench->drawnParticles[phase]) {
+            printf("Fused draw shaded some vertices more than once, those particles were stepped twice "
+                   "and the fused timing is not comparable\n");
+        }
+    }
+    glDeleteQueries(2, bench->invocationQueries);
+    bench->invocationQueries[0] = bench->invocationQueries[1] = 0;
+}
+
+static void finish_render_benchmark(World* world) {
+    RenderBenchmark* bench = &world->renderBenchmark;
+    const char* names[2] = { "two-pass", "fused" };
+    for (int phase = 0; phase < 2; phase++) {
+        if (bench->samples[phase] == 0) {
+            printf("%-9s unavailable\n", names[phase]);
+            continue;
+        }
+        printf("%-9s %8.3f ms GPU (step + draw) %8.3f ms frame, %d particles\n", names[phase],
+               bench->gpuMs[phase] / bench->samples[phase], bench->frameMs[phase] / bench->samples[phase],
+               world->particles.count);
+    }
+    if (bench->samples[0] > 0 && bench->samples[1] > 0) {
+        double twoPass = bench->gpuMs[0] / bench->samples[0];
+        double fused = bench->gpuMs[1] / bench->samples[1];
+        printf("Fused GPU time is %.1f%% of two-pass\n", twoPass > 0.0 ? fused / twoPass * 100.0 : 0.0);
+    }
+    report_invocations(bench, names);
+
+    world->particles.fused = bench->savedFused;
+    world->particles.stats.enabled = bench->savedStats;
+    world->budget.enabled = bench->savedBudget;
+    bench->requested = false;
+    bench->running = false;
+    glfwSetWindowShouldClose(world->window, 1);
+}
+
+// Stats and the budget are held off so both paths do the same work on the
+// same particle count
+static void step_render_benchmark(World* world, float deltaTime) {
+    RenderBenchmark* bench = &world->renderBenchmark;
+    ParticleSystem* ps = &world->particles;
+    if (!bench->running) {
+        bench->running = true;
+        bench->savedFused = ps->fused;
+        bench->savedStats = ps->stats.enabled;
+        bench->savedBudget = world->budget.enabled;
+        ps->stats.enabled = false;
+        world->budget.enabled = false;
+        if (invocation_count_supported()) {
+            glGenQueries(2, bench->invocationQueries);
+        }
+        printf("Comparing two-pass and fused particle updates over %d frames each\n", RENDER_BENCH_FRAMES);
+    }
+
+    // First measured frame of each path
+    bench->countPhase = bench->invocationQueries[0] && bench->frame == RENDER_BENCH_WARMUP + 1 ? bench->phase : -1;
+
+    if (bench->frame == 0) {
+        if (bench->phase == 1 && !ps->fusedSupported) {
+            finish_render_benchmark(world);
+            return;
+        }
+        ps->fused = bench->phase == 1;
+    } else if (bench->frame > RENDER_BENCH_WARMUP) {
+        bench->gpuMs[bench->phase] += ps->stepTimeMs + ps->drawTimeMs;
+        bench->frameMs[bench->phase] += deltaTime * 1000.0;
+        bench->samples[bench->phase]++;
+    }
+
+    if (++bench->frame > RENDER_BENCH_WARMUP + RENDER_BENCH_FRAMES) {
+        bench->frame = 0;
+        if (++bench->phase == 2) {
+            finish_render_benchmark(world);
+        }
+    }
+}
+
 void world_render(World* world, Camera* camera) {
     static float lastFrame = 0.0f;
     float currentFrame = glfwGetTime();
@@ -35,8 +229,36 @@ void world_render(World* world, Camera* camera) {
     
     world->particles.deltaTime = deltaTime;
 
+    // Bring in particles generated since the last frame
+    particle_system_stream(&world->particles);
+    float loadProgress = particle_system_load_progress(&world->particles);
+
+    // Adjust active particle count from last measured GPU timings, once the
+    // pool is loaded and the count is no longer growing on its own
+    if (loadProgress >= 1.0f) {
+        int activeCount = budget_update(&world->budget, world->particles.stepTimeMs,
+                                        world->particles.drawTimeMs, world->particles.count);
+        if (activeCount != world->particles.count) {
+            // Rounding per run is not an outside change, keep the samples
+            world->budget.lastCount = particle_system_set_active_count(&world->particles, activeCount);
+        }
+    }
+
+    if (world->renderBenchmark.requested && loadProgress >= 1.0f) {
+        step_render_benchmark(world, deltaTime);
+    }
+
+    // Left drag stirs the fluid, unless it is dragging a window or slider
+    bool dragging = glfwGetMouseButton(world->window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS &&
+                    !ui_wants_mouse();
+    fluid_set_mouse(&world->fluid, world->particles.mousePos[0], world->particles.mousePos[1], dragging);
+    fluid_step(&world->fluid, deltaTime);
+
     // Update particles
     particle_system_update(&world->particles);
+    kernel_tuner_step(&world->kernelTuner, &world->particles);
+    apply_brush(world, deltaTime);
+    particle_export_frame(&world->exporter, &world->particles);
 
     // Clear buffers
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -51,7 +273,17 @@ void world_render(World* world, Camera* camera) {
     grid_render(&world->grid, (float*)view, (float*)projection);
 
     // Render particles
+    RenderBenchmark* bench = &world->renderBenchmark;
+    bool countInvocations = bench->running && bench->countPhase >= 0;
+    if (countInvocations) {
+        glBeginQuery(GL_VERTEX_SHADER_INVOCATIONS, bench->invocationQueries[bench->countPhase]);
+    }
     particle_system_render(&world->particles, view, projection);
+    if (countInvocations) {
+        glEndQuery(GL_VERTEX_SHADER_INVOCATIONS);
+        bench->drawnParticles[bench->countPhase] = world->particles.count;
+        bench->countPhase = -1;
+    }
     
     // Calculate FPS and frame time
     static float fps = 0.0f;
@@ -67,6 +299,31 @@ void world_render(World* world, Camera* camera) {
     
     // Update HUD stats
     hud_update_stats(&world->hud, fps, world->particles.count, frameTime, deltaTime);
+    hud_update_budget(&world->hud, world->budget.enabled,
+                      budget_decision_name(world->budget.decision),
+                      world->budget.stepMs, world->budget.drawMs, world->particles.fusedDrawn,
+                      world->budget.targetMs, world->particles.numParticles);
+    hud_update_particle_stats(&world->hud, &world->particles.stats.latest);
+    hud_update_loading(&world->hud, loadProgress);
+    hud_update_fluid(&world->hud, world->fluid.enabled, fluid_solver_name(world->fluid.solver),
+                     world->fluid.solveTimeMs);
+    hud_update_activity(&world->hud, world->particles.activeKernel.sparse,
+                        world->particles.activity.activeTiles, world->particles.activity.totalTiles);
+    hud_update_export(&world->hud, world->exporter.header != NULL, world->exporter.published,
+                      world->exporter.dropped, world->exporter.publishTimeMs);
+    hud_update_brush(&world->hud, world->brush.op != BRUSH_NONE, brush_op_name(world->brush.op),
+                     world->spatialIndex.matches, world->spatialIndex.cellsVisited,
+                     world->spatialIndex.buildTimeMs, world->spatialIndex.queryTimeMs);
+
+    // Worker utilization, sampled at the HUD rate
+    static float jobSampleTimer = 0.0f;
+    jobSampleTimer += deltaTime;
+    if (jobSampleTimer >= 0.5f) {
+        float utilization[JOB_MAX_WORKERS];
+        int workers = job_system_utilization(utilization, JOB_MAX_WORKERS);
+        hud_update_jobs(&world->hud, utilization, workers);
+        jobSampleTimer = 0.0f;
+    }
     
     // Start ImGui frame and render UI components
     ui_render(&world->ui, world);  // Start frame and render menu
@@ -79,10 +336,49 @@ void world_render(World* world, Camera* camera) {
 void world_cleanup(World* world) {
     grid_cleanup(&world->grid);
     particle_system_cleanup(&world->particles);
+    fluid_cleanup(&world->fluid);
+    particle_export_cleanup(&world->exporter);
+    spatial_index_cleanup(&world->spatialIndex);
+    kernel_tuner_cleanup(&world->kernelTuner);
     ui_cleanup(&world->ui);
     hud_cleanup(&world->hud);
 }
 
+void world_load_scene(World* world, int systemCount, int speciesCount) {
+    ParticleSystem* ps = &world->particles;
+    if (systemCount < 1) systemCount = 1;
+    if (systemCount > MAX_PARTICLE_GROUPS) systemCount = MAX_PARTICLE_GROUPS;
+    if (speciesCount < 1) speciesCount = 1;
+    if (speciesCount > ps->speciesCount) speciesCount = ps->speciesCount;
+
+    particle_system_clear_groups(ps);
+
+    // Lay systems out on a square grid over the -20..20 spawn area
+    int columns = (int)ceilf(sqrtf((float)systemCount));
+    float cell = 40.0f / columns;
+    // Groups start on aligned offsets, so the capacities round down and a
+    // single system holds 64,999,424 rather than the full 65M pool
+    int capacity = (ps->numParticles / systemCount) / PARTICLE_GROUP_ALIGNMENT * PARTICLE_GROUP_ALIGNMENT;
+
+    for (int i = 0; i < systemCount; i++) {
+        ParticleGroupDesc desc;
+        desc.capacity = capacity;
+        desc.center[0] = systemCount == 1 ? 0.0f : -20.0f + cell * (i % columns + 0.5f);
+        desc.center[1] = systemCount == 1 ? 0.0f : -20.0f + cell * (i / columns + 0.5f);
+        desc.extent = systemCount == 1 ? 20.0f : cell * 0.5f;
+        desc.attraction = 2.5f * (1.0f + 0.1f * (i % 5));
+        desc.damping = 0.9998f - 0.0002f * (i % 3);
+        desc.palette = (ps->colormap.palette + i) % COLORMAP_COUNT;
+        desc.seed = (uint32_t)i * 0x9E3779B9u;
+        for (int s = 0; s < PARTICLE_MAX_SPECIES; s++) {
+            desc.speciesMix[s] = s < speciesCount ? 1.0f : 0.0f;
+        }
+        particle_system_add_group(ps, &desc);
+    }
+
+    world->budget.maxCount = particle_system_group_capacity(ps);
+}
+
 void world_set_mouse_pos(World* world, float x, float y) {
     particle_system_set_mouse_pos(&world->particles, x, y);
 }
\ No newline at end of file
@@ -0,0 +1,142 @@
+// Reference consumer for the engine's shared memory particle export. Maps the
+// ring, reduces every new frame in place (no copy out of the mapping) and
+// reports the sustained rate once per second.
+//
+//   particle_consumer [seconds]
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "platform.h"
+#include "particle_export_format.h"
+
+typedef struct {
+    uint64_t frame;
+    uint64_t count;
+    double centerX;
+    double centerY;
+    double meanSpeed;
+} FrameSummary;
+
+// Read one slot under its seqlock, false if the engine overwrote it meanwhile
+static int read_slot(ParticleExportHeader* header, uint32_t index, FrameSummary* out) {
+    ParticleExportSlot* slot = particle_export_slot(header, index);
+    uint32_t before = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+    if (before & 1u) {
+        return 0;
+    }
+
+    uint64_t count = slot->count;
+    if (count > header->slotCapacity) {
+        return 0;
+    }
+    const float* positions = (const float*)((unsigned char*)slot + header->positionOffset);
+    const float* velocities = (const float*)((unsigned char*)slot + header->velocityOffset);
+
+    double sumX = 0.0, sumY = 0.0, sumSpeed = 0.0;
+    for (uint64_t i = 0; i < count; i++) {
+        sumX += positions[2 * i];
+        sumY += positions[2 * i + 1];
+        float vx = velocities[2 * i];
+        float vy = velocities[2 * i + 1];
+        sumSpeed += sqrtf(vx * vx + vy * vy);
+    }
+    uint64_t frame = slot->frame;
+
+    atomic_thread_fence(memory_order_acquire);
+    if (atomic_load_explicit(&slot->sequence, memory_order_relaxed) != before) {
+        return 0;
+    }
+
+    double inv = count > 0 ? 1.0 / (double)count : 0.0;
+    out->frame = frame;
+    out->count = count;
+    out->centerX = sumX * inv;
+    out->centerY = sumY * inv;
+    out->meanSpeed = sumSpeed * inv;
+    return 1;
+}
+
+int main(int argc, char** argv) {
+    double duration = argc > 1 ? atof(argv[1]) : 10.0;
+
+    PlatformSharedMemory shm;
+    if (!platform_shared_memory_open(&shm, PARTICLE_EXPORT_NAME)) {
+        fprintf(stderr, "No particle export at %s, enable it in the engine first\n", PARTICLE_EXPORT_NAME);
+        return 1;
+    }
+
+    ParticleExportHeader* header = (ParticleExportHeader*)shm.memory;
+    if (shm.size < sizeof(*header) || header->magic != PARTICLE_EXPORT_MAGIC ||
+        header->version != PARTICLE_EXPORT_VERSION) {
+        fprintf(stderr, "%s is not a version %d particle export\n", PARTICLE_EXPORT_NAME, PARTICLE_EXPORT_VERSION);
+        platform_shared_memory_close(&shm, false);
+        return 1;
+    }
+    atomic_thread_fence(memory_order_acquire);
+    printf("Mapped %s: %u slots of %llu particles, %.1f MB\n", PARTICLE_EXPORT_NAME, header->slotCount,
+           (unsigned long long)header->slotCapacity, shm.size / (1024.0 * 1024.0));
+
+    double start = platform_time_seconds();
+    double reportTime = start;
+    uint64_t lastFrame = 0;
+    int haveFrame = 0;
+    uint64_t frames = 0, skipped = 0, torn = 0, bytes = 0;
+    uint64_t totalFrames = 0, totalSkipped = 0, totalTorn = 0;
+    FrameSummary summary = {0};
+
+    while (atomic_load_explicit(&header->alive, memory_order_acquire)) {
+        double now = platform_time_seconds();
+        if (now - start >= duration) {
+            break;
+        }
+
+        uint64_t latest = atomic_load_explicit(&header->latestFrame, memory_order_acquire);
+        uint32_t index = atomic_load_explicit(&header->latestSlot, memory_order_relaxed);
+        bool written = header->slotCount > 0 &&
+                       atomic_load_explicit(&particle_export_slot(header, index % header->slotCount)->sequence,
+                                            memory_order_relaxed) != 0;
+        if (!written || (haveFrame && latest == lastFrame)) {
+            platform_yield();
+        } else if (read_slot(header, index % header->slotCount, &summary)) {
+            if (haveFrame && summary.frame > lastFrame + 1) {
+                skipped += summary.frame - lastFrame - 1;
+            }
+            if (!haveFrame || summary.frame > lastFrame) {
+                lastFrame = summary.frame;
+                haveFrame = 1;
+                frames++;
+                bytes += summary.count * 2 * 2 * sizeof(float);
+            }
+        } else {
+            torn++;
+        }
+
+        if (now - reportTime >= 1.0) {
+            double seconds = now - reportTime;
+            printf("%6.1f fps  %9llu particles  %6.2f GB/s  skipped %llu  torn %llu  "
+                   "center (%.2f, %.2f)  mean speed %.3f\n",
+                   frames / seconds, (unsigned long long)summary.count, bytes / seconds / 1e9,
+                   (unsigned long long)skipped, (unsigned long long)torn,
+                   summary.centerX, summary.centerY, summary.meanSpeed);
+            totalFrames += frames;
+            totalSkipped += skipped;
+            totalTorn += torn;
+            frames = skipped = torn = bytes = 0;
+            reportTime = now;
+        }
+    }
+
+    if (!atomic_load_explicit(&header->alive, memory_order_acquire)) {
+        printf("Engine stopped publishing\n");
+    }
+    double elapsed = platform_time_seconds() - start;
+    totalFrames += frames;
+    totalSkipped += skipped;
+    totalTorn += torn;
+    printf("Sustained %.1f fps over %.1f s, %llu frames skipped, %llu torn reads\n",
+           totalFrames / elapsed, elapsed, (unsigned long long)totalSkipped, (unsigned long long)totalTorn);
+
+    platform_shared_memory_close(&shm, false);
+    return 0;
+}